@@ -7,4 +7,7 @@
 
 #cmakedefine TEST_DIRECTORY "@TEST_DIRECTORY@"
 
+/* Default location of the modules */
+#cmakedefine KURENTO_MODULES_DIR "@KURENTO_MODULES_DIR@"
+
 #endif /* __KMSC_CONFIG_H__ */
@@ -0,0 +1,325 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "AdmissionControl.hpp"
+
+#include <KurentoException.hpp>
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#define GST_CAT_DEFAULT kurento_admission_control
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "KurentoAdmissionControl"
+
+/* Every creation is observed until the model has these observations, then
+ * one of each COST_OBSERVATION_INTERVAL, to follow changes */
+#define COST_LEARNING_OBSERVATIONS 10
+#define COST_OBSERVATION_INTERVAL 100
+/* Weight of a new observation in the average cost */
+#define COST_SMOOTHING 0.2
+#define MAX_RETRY_AFTER std::chrono::seconds (30)
+
+namespace kurento
+{
+
+static void
+addUsage (ResourceUsage &usage, const ResourceUsage &other, int sign)
+{
+  usage.threads += sign * other.threads;
+  usage.openFiles += sign * other.openFiles;
+  usage.memory += sign * other.memory;
+}
+
+static void
+updateCost (double &cost, long int observed, bool first)
+{
+  observed = std::max (observed, 0L);
+  cost = first ? observed : cost + COST_SMOOTHING * (observed - cost);
+}
+
+AdmissionControl::Ticket::Ticket (AdmissionControl *admission,
+                                  const std::string &factory, const ResourceUsage &cost) :
+  admission (admission), factory (factory), cost (cost)
+{
+}
+
+AdmissionControl::Ticket::Ticket (Ticket &&ticket) :
+  admission (ticket.admission), factory (std::move (ticket.factory) ),
+  cost (ticket.cost), observe (ticket.observe), admissions (ticket.admissions),
+  before (ticket.before)
+{
+  ticket.admission = nullptr;
+}
+
+AdmissionControl::Ticket::~Ticket ()
+{
+  if (admission == nullptr) {
+    return;
+  }
+
+  /* The creation failed */
+  std::unique_lock<std::mutex> lock (admission->mutex);
+
+  admission->inProgress--;
+  admission->release (cost);
+}
+
+void
+AdmissionControl::Ticket::finish ()
+{
+  if (admission == nullptr) {
+    return;
+  }
+
+  admission->finish (*this);
+  admission = nullptr;
+}
+
+AdmissionControl::AdmissionControl (float limitPercent,
+                                    const boost::property_tree::ptree &config) :
+  limitPercent (limitPercent)
+{
+  cpuLimit = config.get<float> ("mediaServer.resources.cpuLimit", 0);
+
+  if (cpuLimit > 0) {
+    GST_INFO ("Using above %.0f%% of the available CPU will reject creations",
+              cpuLimit * 100.0f);
+  }
+
+  auto costs = config.get_child_optional ("mediaServer.resources.factoryCosts");
+
+  if (!costs) {
+    return;
+  }
+
+  for (auto &factory : *costs) {
+    Model &model = models[factory.first];
+
+    model.threads = factory.second.get<double> ("threads", 0);
+    model.openFiles = factory.second.get<double> ("openFiles", 0);
+    model.memory = factory.second.get<double> ("memory", 0);
+    model.configured = true;
+
+    GST_INFO ("Configured cost of %s: %.1f threads, %.1f open files, "
+              "%.0f bytes", factory.first.c_str (), model.threads, model.openFiles,
+              model.memory);
+  }
+}
+
+AdmissionControl::Ticket
+AdmissionControl::admit (const std::string &factory)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+  Model &model = models[factory];
+  ResourceUsage cost = {(long int) std::ceil (model.threads),
+                        (long int) std::ceil (model.openFiles),
+                        (long int) std::ceil (model.memory)
+                       };
+  ResourceUsage extra;
+
+  releasePending ();
+  /* Reserved before checking, so concurrent calls are checked against the
+   * cost of this one too */
+  addUsage (reserved, cost, 1);
+  extra = reserved;
+
+  /* Checks may measure the usage, creations must not wait for that */
+  lock.unlock ();
+
+  try {
+    checkCpu ();
+    checkResources (limitPercent, extra);
+  } catch (KurentoException &) {
+    lock.lock ();
+    release (cost);
+    rejections++;
+    setRejecting (true);
+    throw;
+  }
+
+  lock.lock ();
+  setRejecting (false);
+
+  inProgress++;
+  admissions++;
+  model.creations++;
+
+  Ticket ticket (this, factory, cost);
+
+  ticket.observe = !model.configured && inProgress == 1 &&
+                   (model.observations < COST_LEARNING_OBSERVATIONS ||
+                    model.creations % COST_OBSERVATION_INTERVAL == 0);
+  ticket.admissions = admissions;
+
+  lock.unlock ();
+
+  if (ticket.observe) {
+    ticket.before = measureResourceUsage ();
+  }
+
+  return ticket;
+}
+
+void
+AdmissionControl::finish (Ticket &ticket)
+{
+  ResourceUsage after{0, 0, 0};
+
+  if (ticket.observe) {
+    after = measureResourceUsage ();
+  }
+
+  std::unique_lock<std::mutex> lock (mutex);
+  uint64_t sample = getResourceSampleCount ();
+
+  inProgress--;
+
+  if (sample == 0) {
+    /* Without sampler every check measures the current usage */
+    release (ticket.cost);
+  } else {
+    pending.push_back ({sample, ticket.cost});
+  }
+
+  /* Discarded if other creations overlapped with this one */
+  if (ticket.observe && ticket.admissions == admissions) {
+    Model &model = models[ticket.factory];
+    bool first = (model.observations == 0);
+
+    addUsage (after, ticket.before, -1);
+    updateCost (model.threads, after.threads, first);
+    updateCost (model.openFiles, after.openFiles, first);
+    updateCost (model.memory, after.memory, first);
+    model.observations++;
+
+    GST_DEBUG ("Observed cost of %s: %ld threads, %ld open files, %ld bytes",
+               ticket.factory.c_str (), after.threads, after.openFiles, after.memory);
+  }
+}
+
+/* CPU load is a rate, the last sample is used as is */
+void
+AdmissionControl::checkCpu ()
+{
+  double cpuLoad = getCpuLoad ();
+
+  if (cpuLimit <= 0 || cpuLoad <= cpuLimit) {
+    return;
+  }
+
+  std::ostringstream oss;
+  oss << "Reached KMS CPU limit: " << cpuLimit * 100.0f << "%";
+  std::string exMessage = oss.str();
+
+  oss << " (current: " << cpuLoad * 100.0 << "% of " << getCpuLimit ()
+      << " CPUs)";
+  std::string logMessage = oss.str();
+
+  GST_WARNING ("%s", logMessage.c_str() );
+  throw KurentoException (NOT_ENOUGH_RESOURCES, exMessage);
+}
+
+void
+AdmissionControl::setRejecting (bool rejecting)
+{
+  if (rejecting && !this->rejecting) {
+    rejectingSince = std::chrono::steady_clock::now ();
+  }
+
+  this->rejecting = rejecting;
+}
+
+/* At least a sampling period, when the usage is measured again, and then
+ * as long as rejections have lasted */
+std::chrono::milliseconds
+AdmissionControl::getRetryAfter ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+  std::chrono::milliseconds retryAfter = std::max (getResourceSamplingPeriod (),
+                                         std::chrono::milliseconds (1000) );
+
+  if (rejecting) {
+    retryAfter = std::max (retryAfter,
+                           std::chrono::duration_cast<std::chrono::milliseconds>
+                           (std::chrono::steady_clock::now () - rejectingSince) );
+  }
+
+  return std::min<std::chrono::milliseconds> (retryAfter, MAX_RETRY_AFTER);
+}
+
+bool
+AdmissionControl::isCpuOverloaded ()
+{
+  return cpuLimit > 0 && getCpuLoad () > cpuLimit;
+}
+
+void
+AdmissionControl::release (const ResourceUsage &cost)
+{
+  addUsage (reserved, cost, -1);
+}
+
+/* Usage of creations sampled after they finished is already in the samples.
+ * A sample in progress when they finished may have missed it, so two more
+ * samples are waited for */
+void
+AdmissionControl::releasePending ()
+{
+  uint64_t sample = getResourceSampleCount ();
+
+  while (!pending.empty () &&
+         (sample == 0 || sample >= pending.front ().sample + 2) ) {
+    release (pending.front ().cost);
+    pending.pop_front ();
+  }
+}
+
+void
+AdmissionControl::getStats (Json::Value &stats)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  stats["admissions"] = (Json::UInt64) admissions;
+  stats["rejections"] = (Json::UInt64) rejections;
+  stats["rejecting"] = rejecting;
+  stats["reserved"]["threads"] = (Json::Int64) reserved.threads;
+  stats["reserved"]["openFiles"] = (Json::Int64) reserved.openFiles;
+  stats["reserved"]["memory"] = (Json::Int64) reserved.memory;
+  stats["factories"] = Json::Value (Json::objectValue);
+
+  for (auto &it : models) {
+    Json::Value &model = stats["factories"][it.first];
+
+    model["threads"] = it.second.threads;
+    model["openFiles"] = it.second.openFiles;
+    model["memory"] = it.second.memory;
+    model["observations"] = (Json::UInt64) it.second.observations;
+    model["configured"] = it.second.configured;
+  }
+}
+
+} /* kurento */
+
+static void init_debug() __attribute__((constructor));
+
+static void init_debug() {
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+                           GST_DEFAULT_NAME);
+}
@@ -0,0 +1,137 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __ADMISSION_CONTROL_HPP__
+#define __ADMISSION_CONTROL_HPP__
+
+#include "ResourceManager.hpp"
+
+#include <boost/property_tree/ptree.hpp>
+#include <json/json.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace kurento
+{
+
+/*
+ * Admission of create calls by the resources they are expected to use.
+ *
+ * The cost of each factory in threads, open files and memory is configured
+ * or learned from the usage observed around the object creation, averaged
+ * over time. Only creations that do not overlap with others are observed,
+ * so concurrent calls do not pollute the measurements.
+ *
+ * The predicted cost of a creation is reserved until the resource sampler
+ * has taken it into account, so a burst of calls is checked against its
+ * whole cost and not only against the last sample.
+ *
+ * Creations are also rejected while the CPU load of the process is above
+ * the configured limit. Rejected clients get a hint of when to retry, which
+ * grows while the overload lasts.
+ */
+class AdmissionControl
+{
+public:
+  class Ticket
+  {
+  public:
+    Ticket (const Ticket &) = delete;
+    Ticket (Ticket &&ticket);
+    ~Ticket ();
+
+    /* The object has been created, the reservation is kept until the next
+     * samples of the resource usage */
+    void finish ();
+
+  private:
+    friend class AdmissionControl;
+
+    Ticket (AdmissionControl *admission, const std::string &factory,
+            const ResourceUsage &cost);
+
+    AdmissionControl *admission;
+    std::string factory;
+    ResourceUsage cost;
+    bool observe = false;
+    uint64_t admissions = 0;
+    ResourceUsage before{0, 0, 0};
+  };
+
+  AdmissionControl (float limitPercent,
+                    const boost::property_tree::ptree &config);
+
+  /* Throws NOT_ENOUGH_RESOURCES if creating an object of the factory is
+   * expected to exceed the limits */
+  Ticket admit (const std::string &factory);
+
+  /* Time for clients to wait before retrying a rejected creation */
+  std::chrono::milliseconds getRetryAfter ();
+
+  /* Whether creations are rejected now because of the CPU load. Unlike
+   * the "rejecting" stat, other resources are not checked, as that needs a
+   * cost to check against */
+  bool isCpuOverloaded ();
+
+  void getStats (Json::Value &stats);
+
+private:
+  struct Model {
+    double threads = 0;
+    double openFiles = 0;
+    double memory = 0;
+    uint64_t observations = 0;
+    uint64_t creations = 0;
+    bool configured = false;
+  };
+
+  struct Pending {
+    uint64_t sample;
+    ResourceUsage cost;
+  };
+
+  void release (const ResourceUsage &cost);
+  void releasePending ();
+  void finish (Ticket &ticket);
+  void checkCpu ();
+  void setRejecting (bool rejecting);
+
+  float limitPercent;
+  /* Fraction of the available CPUs, 0 if disabled */
+  float cpuLimit;
+
+  std::mutex mutex;
+  std::map<std::string, Model> models;
+  /* Cost of the creations in progress and of those not sampled yet */
+  ResourceUsage reserved{0, 0, 0};
+  std::deque<Pending> pending;
+  int inProgress = 0;
+  uint64_t admissions = 0;
+  uint64_t rejections = 0;
+  /* Whether the last creation was rejected, for any resource */
+  bool rejecting = false;
+  std::chrono::steady_clock::time_point rejectingSince;
+};
+
+} /* kurento */
+
+#endif /* __ADMISSION_CONTROL_HPP__ */
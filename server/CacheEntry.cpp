@@ -17,68 +17,34 @@
 
 #include "CacheEntry.hpp"
 #include <gst/gst.h>
-#include <config.h>
+
+#include <utility>
 
 #define GST_CAT_DEFAULT kurento_cache_entry
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "KurentoCacheEntry"
 
-using namespace Glib::Threads;
-
-/* Next stuff is included to avoid problems with slots and lamdas */
-#include <type_traits>
-#include <sigc++/sigc++.h>
-#include <event2/event_struct.h>
-#if FIX_SIGC
-namespace sigc
-{
-template <typename Functor>
-struct functor_trait<Functor, false> {
-  typedef decltype (::sigc::mem_fun (std::declval<Functor &> (),
-                                     &Functor::operator() ) ) _intermediate;
-
-  typedef typename _intermediate::result_type result_type;
-  typedef Functor functor_type;
-};
-}
-#endif
-
 namespace kurento
 {
 
-CacheEntry::CacheEntry (unsigned int timeout, std::string sessionId,
-                        std::string requestId, Json::Value &response)
+CacheEntry::CacheEntry (uint64_t expiration, std::string sessionId,
+                        std::string requestId,
+                        std::shared_ptr<const std::string> response,
+                        std::string responseSessionId)
+  : expiration (expiration), sessionId (std::move (sessionId) ),
+    requestId (std::move (requestId) ), response (std::move (response) ),
+    responseSessionId (std::move (responseSessionId) )
 {
-  this->sessionId = sessionId;
-  this->requestId = requestId;
-  this->response = response;
-  this->timedout = false;
-
-  this->source = Glib::TimeoutSource::create (timeout);
-  source->connect ( [this] () -> bool {
-    std::unique_lock<std::recursive_mutex> lock (this->mutex);
-    this->timedout = true;
-    lock.unlock();
-
-    this->signalTimeout.emit();
+  size = sizeof (CacheEntry) + this->sessionId.size () + this->requestId.size ()
+         + this->responseSessionId.size ();
 
-    return false;
-  });
-
-  source->attach();
-}
-
-Json::Value &CacheEntry::getResponse() { return response; }
-
-CacheEntry::~CacheEntry ()
-{
-  std::unique_lock<std::recursive_mutex> lock (mutex);
-
-  if (!timedout) {
-    source->destroy();
+  if (this->response) {
+    size += this->response->size ();
   }
 }
 
+CacheEntry::~CacheEntry () = default;
+
 CacheEntry::StaticConstructor CacheEntry::staticConstructor;
 
 CacheEntry::StaticConstructor::StaticConstructor()
@@ -18,32 +18,67 @@
 #ifndef __CACHE_ENTRY_H__
 #define __CACHE_ENTRY_H__
 
-#include <glibmm.h>
-#include <mutex>
-
-#include <json/json.h>
+#include <cstdint>
+#include <memory>
+#include <string>
 
 namespace kurento
 {
 
+/*
+ * Cached response of a request, stored already serialized so that replaying
+ * it needs neither a copy of the JSON tree nor a new serialization. Entries
+ * are immutable and carry no timer of their own: they are expired in batches
+ * by the TimerWheel of the RequestCache shard that holds them, once the wheel
+ * reaches their expiration tick.
+ */
 class CacheEntry
 {
 public:
-  CacheEntry (unsigned int timeout, std::string sessionId, std::string requestId,
-              Json::Value &response);
-  Json::Value &getResponse (void);
+  CacheEntry (uint64_t expiration, std::string sessionId, std::string requestId,
+              std::shared_ptr<const std::string> response,
+              std::string responseSessionId);
   ~CacheEntry ();
 
-  sigc::signal<void> signalTimeout;
+  const std::shared_ptr<const std::string> &getResponse () const
+  {
+    return response;
+  }
 
+  /* SessionId that processing the original request resulted in */
+  const std::string &getResponseSessionId () const
+  {
+    return responseSessionId;
+  }
+
+  const std::string &getSessionId () const
+  {
+    return sessionId;
+  }
+
+  const std::string &getRequestId () const
+  {
+    return requestId;
+  }
+
+  uint64_t getExpiration () const
+  {
+    return expiration;
+  }
+
+  /* Approximate memory used by the entry, for cache accounting */
+  size_t getSize () const
+  {
+    return size;
+  }
 
 private:
-  Glib::RefPtr<Glib::TimeoutSource> source;
-  std::recursive_mutex mutex;
+  uint64_t expiration;
   std::string sessionId;
   std::string requestId;
-  Json::Value response;
-  bool timedout;
+  std::shared_ptr<const std::string> response;
+  std::string responseSessionId;
+  size_t size;
 
   class StaticConstructor
   {
@@ -0,0 +1,484 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "CborUtils.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+/* Nesting limit when reading, as the one of the jsoncpp reader */
+#define CBOR_MAX_DEPTH 1000
+
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_NULL 22
+#define CBOR_UNDEFINED 23
+#define CBOR_HALF 25
+#define CBOR_FLOAT 26
+#define CBOR_DOUBLE 27
+#define CBOR_INDEFINITE 31
+
+namespace kurento
+{
+
+namespace
+{
+
+void
+writeHeader (std::string &out, int type, uint64_t argument)
+{
+  char header[9];
+  int size;
+
+  if (argument < 24) {
+    out.push_back ( (char) ( (type << 5) | argument) );
+    return;
+  } else if (argument <= 0xff) {
+    header[0] = (char) ( (type << 5) | 24);
+    size = 1;
+  } else if (argument <= 0xffff) {
+    header[0] = (char) ( (type << 5) | 25);
+    size = 2;
+  } else if (argument <= 0xffffffff) {
+    header[0] = (char) ( (type << 5) | 26);
+    size = 4;
+  } else {
+    header[0] = (char) ( (type << 5) | 27);
+    size = 8;
+  }
+
+  for (int i = size; i > 0; i--) {
+    header[i] = (char) (argument & 0xff);
+    argument >>= 8;
+  }
+
+  out.append (header, size + 1);
+}
+
+void
+writeString (std::string &out, int type, const char *begin, const char *end)
+{
+  writeHeader (out, type, end - begin);
+  out.append (begin, end - begin);
+}
+
+void
+writeValue (std::string &out, const Json::Value &value)
+{
+  switch (value.type () ) {
+  case Json::nullValue:
+    out.push_back ( (char) ( (CBOR_SIMPLE << 5) | CBOR_NULL) );
+    break;
+
+  case Json::booleanValue:
+    out.push_back ( (char) ( (CBOR_SIMPLE << 5) |
+                             (value.asBool () ? CBOR_TRUE : CBOR_FALSE) ) );
+    break;
+
+  case Json::intValue: {
+    Json::Int64 n = value.asInt64 ();
+
+    if (n >= 0) {
+      writeHeader (out, CBOR_UNSIGNED, n);
+    } else {
+      writeHeader (out, CBOR_NEGATIVE, - (n + 1) );
+    }
+
+    break;
+  }
+
+  case Json::uintValue:
+    writeHeader (out, CBOR_UNSIGNED, value.asUInt64 () );
+    break;
+
+  case Json::realValue: {
+    double d = value.asDouble ();
+    uint64_t bits;
+
+    std::memcpy (&bits, &d, sizeof (bits) );
+    out.push_back ( (char) ( (CBOR_SIMPLE << 5) | CBOR_DOUBLE) );
+
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      out.push_back ( (char) ( (bits >> shift) & 0xff) );
+    }
+
+    break;
+  }
+
+  case Json::stringValue: {
+    const char *begin;
+    const char *end;
+
+    value.getString (&begin, &end);
+    writeString (out, CBOR_TEXT, begin, end);
+    break;
+  }
+
+  case Json::arrayValue:
+    writeHeader (out, CBOR_ARRAY, value.size () );
+
+    for (const Json::Value &item : value) {
+      writeValue (out, item);
+    }
+
+    break;
+
+  case Json::objectValue:
+    writeHeader (out, CBOR_MAP, value.size () );
+
+    for (auto it = value.begin (); it != value.end (); it++) {
+      const char *end;
+      const char *begin = it.memberName (&end);
+
+      writeString (out, CBOR_TEXT, begin, end);
+      writeValue (out, *it);
+    }
+
+    break;
+  }
+}
+
+class CborReader
+{
+public:
+  CborReader (const std::string &data) :
+    pos ( (const uint8_t *) data.data () ), end (pos + data.size () ) {}
+
+  bool read (Json::Value &value)
+  {
+    return readItem (value, 0) && pos == end;
+  }
+
+private:
+  bool readByte (uint8_t &byte)
+  {
+    if (pos == end) {
+      return false;
+    }
+
+    byte = *pos++;
+    return true;
+  }
+
+  bool readUInt (int size, uint64_t &result)
+  {
+    if (end - pos < size) {
+      return false;
+    }
+
+    result = 0;
+
+    for (int i = 0; i < size; i++) {
+      result = (result << 8) | *pos++;
+    }
+
+    return true;
+  }
+
+  /* Reads the argument of an item header, indefinite lengths are returned
+   * as such and must be checked by the caller */
+  bool readArgument (uint8_t info, uint64_t &argument, bool &indefinite)
+  {
+    indefinite = false;
+
+    if (info < 24) {
+      argument = info;
+      return true;
+    }
+
+    switch (info) {
+    case 24:
+      return readUInt (1, argument);
+
+    case 25:
+      return readUInt (2, argument);
+
+    case 26:
+      return readUInt (4, argument);
+
+    case 27:
+      return readUInt (8, argument);
+
+    case CBOR_INDEFINITE:
+      indefinite = true;
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+  bool isBreak ()
+  {
+    if (pos != end && *pos == 0xff) {
+      pos++;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool readChunk (uint64_t length, std::string &out)
+  {
+    if ( (uint64_t) (end - pos) < length) {
+      return false;
+    }
+
+    out.append ( (const char *) pos, length);
+    pos += length;
+
+    return true;
+  }
+
+  bool readString (int type, uint8_t info, std::string &out)
+  {
+    uint64_t length;
+    bool indefinite;
+
+    if (!readArgument (info, length, indefinite) ) {
+      return false;
+    }
+
+    if (!indefinite) {
+      return readChunk (length, out);
+    }
+
+    /* Chunks of definite length of the same type, up to a break */
+    while (!isBreak () ) {
+      uint8_t byte;
+
+      if (!readByte (byte) || (byte >> 5) != type
+          || !readArgument (byte & 0x1f, length, indefinite) || indefinite
+          || !readChunk (length, out) ) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool readFloat (uint8_t info, Json::Value &value)
+  {
+    uint64_t bits;
+
+    switch (info) {
+    case CBOR_HALF: {
+      if (!readUInt (2, bits) ) {
+        return false;
+      }
+
+      int exponent = (bits >> 10) & 0x1f;
+      double mantissa = bits & 0x3ff;
+      double d;
+
+      if (exponent == 0) {
+        d = std::ldexp (mantissa, -24);
+      } else if (exponent != 31) {
+        d = std::ldexp (mantissa + 1024, exponent - 25);
+      } else {
+        d = mantissa == 0 ? std::numeric_limits<double>::infinity () :
+            std::numeric_limits<double>::quiet_NaN ();
+      }
+
+      value = (bits & 0x8000) ? -d : d;
+      return true;
+    }
+
+    case CBOR_FLOAT: {
+      uint32_t fbits;
+      float f;
+
+      if (!readUInt (4, bits) ) {
+        return false;
+      }
+
+      fbits = (uint32_t) bits;
+      std::memcpy (&f, &fbits, sizeof (f) );
+      value = (double) f;
+      return true;
+    }
+
+    case CBOR_DOUBLE: {
+      double d;
+
+      if (!readUInt (8, bits) ) {
+        return false;
+      }
+
+      std::memcpy (&d, &bits, sizeof (d) );
+      value = d;
+      return true;
+    }
+
+    default:
+      return false;
+    }
+  }
+
+  bool readItem (Json::Value &value, int depth)
+  {
+    uint8_t byte;
+    uint64_t argument;
+    bool indefinite;
+
+    if (depth > CBOR_MAX_DEPTH || !readByte (byte) ) {
+      return false;
+    }
+
+    int type = byte >> 5;
+    uint8_t info = byte & 0x1f;
+
+    switch (type) {
+    case CBOR_UNSIGNED:
+      if (!readArgument (info, argument, indefinite) || indefinite) {
+        return false;
+      }
+
+      /* Same types as the JSON reader gives, so values compare equal */
+      if (argument <= (uint64_t) Json::Value::maxInt) {
+        value = (Json::Int64) argument;
+      } else {
+        value = (Json::UInt64) argument;
+      }
+
+      return true;
+
+    case CBOR_NEGATIVE:
+      if (!readArgument (info, argument, indefinite) || indefinite
+          || argument > (uint64_t) std::numeric_limits<Json::Int64>::max () ) {
+        return false;
+      }
+
+      value = - (Json::Int64) argument - 1;
+      return true;
+
+    case CBOR_BYTES:
+    case CBOR_TEXT: {
+      std::string str;
+
+      if (!readString (type, info, str) ) {
+        return false;
+      }
+
+      value = str;
+      return true;
+    }
+
+    case CBOR_ARRAY:
+      if (!readArgument (info, argument, indefinite) ) {
+        return false;
+      }
+
+      value = Json::Value (Json::arrayValue);
+
+      for (uint64_t i = 0; indefinite ? !isBreak () : i < argument; i++) {
+        Json::Value item;
+
+        if (!readItem (item, depth + 1) ) {
+          return false;
+        }
+
+        value.append (item);
+      }
+
+      return true;
+
+    case CBOR_MAP:
+      if (!readArgument (info, argument, indefinite) ) {
+        return false;
+      }
+
+      value = Json::Value (Json::objectValue);
+
+      for (uint64_t i = 0; indefinite ? !isBreak () : i < argument; i++) {
+        std::string key;
+        uint8_t keyByte;
+
+        /* JSON only allows string keys */
+        if (!readByte (keyByte) || (keyByte >> 5) != CBOR_TEXT
+            || !readString (CBOR_TEXT, keyByte & 0x1f, key)
+            || !readItem (value[key], depth + 1) ) {
+          return false;
+        }
+      }
+
+      return true;
+
+    case CBOR_TAG:
+      if (!readArgument (info, argument, indefinite) || indefinite) {
+        return false;
+      }
+
+      return readItem (value, depth + 1);
+
+    default:
+      switch (info) {
+      case CBOR_FALSE:
+        value = false;
+        return true;
+
+      case CBOR_TRUE:
+        value = true;
+        return true;
+
+      case CBOR_NULL:
+      case CBOR_UNDEFINED:
+        value = Json::Value::null;
+        return true;
+
+      default:
+        return readFloat (info, value);
+      }
+    }
+  }
+
+  const uint8_t *pos;
+  const uint8_t *end;
+};
+
+} /* namespace */
+
+void
+writeCbor (const Json::Value &value, std::string &out)
+{
+  out.clear ();
+  writeValue (out, value);
+}
+
+void
+appendCborArrayHeader (size_t size, std::string &out)
+{
+  writeHeader (out, CBOR_ARRAY, size);
+}
+
+bool
+readCbor (const std::string &data, Json::Value &value)
+{
+  return CborReader (data).read (value);
+}
+
+} // kurento
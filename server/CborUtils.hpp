@@ -0,0 +1,46 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __CBOR_UTILS_H__
+#define __CBOR_UTILS_H__
+
+#include <string>
+
+#include <json/json.h>
+
+namespace kurento
+{
+
+/*
+ * CBOR (RFC 8949) encoding of JSON values, used by clients that negotiate the
+ * binary subprotocol. Only the data model of JSON is supported: byte strings
+ * are read as strings, tags are ignored and undefined is read as null.
+ */
+
+/* Encodes value into out, replacing its contents */
+void writeCbor (const Json::Value &value, std::string &out);
+
+/* Appends the header of an array of size items, so that an array can be
+ * written from items already encoded */
+void appendCborArrayHeader (size_t size, std::string &out);
+
+/* Returns false if data is not a single well-formed CBOR item that can be
+ * represented as JSON */
+bool readCbor (const std::string &data, Json::Value &value);
+
+} // kurento
+
+#endif /* __CBOR_UTILS_H__ */
@@ -0,0 +1,150 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "JsonUtils.hpp"
+
+#include <memory>
+#include <ostream>
+#include <streambuf>
+
+namespace kurento
+{
+
+namespace
+{
+
+/* Stream buffer that appends to an external string */
+class StringBuffer : public std::streambuf
+{
+public:
+  void setTarget (std::string *target)
+  {
+    this->target = target;
+  }
+
+protected:
+  int_type overflow (int_type c) override
+  {
+    if (!traits_type::eq_int_type (c, traits_type::eof () ) ) {
+      target->push_back (traits_type::to_char_type (c) );
+    }
+
+    return traits_type::not_eof (c);
+  }
+
+  std::streamsize xsputn (const char *s, std::streamsize n) override
+  {
+    target->append (s, n);
+    return n;
+  }
+
+private:
+  std::string *target = nullptr;
+};
+
+class JsonWriter
+{
+public:
+  JsonWriter () : stream (&buffer)
+  {
+    Json::StreamWriterBuilder writerFactory;
+
+    writerFactory["indentation"] = "";
+    writer.reset (writerFactory.newStreamWriter () );
+  }
+
+  void write (const Json::Value &value, std::string &out)
+  {
+    out.clear ();
+    buffer.setTarget (&out);
+    writer->write (value, &stream);
+    buffer.setTarget (nullptr);
+  }
+
+private:
+  StringBuffer buffer;
+  std::ostream stream;
+  std::unique_ptr<Json::StreamWriter> writer;
+};
+
+} /* namespace */
+
+void
+writeJson (const Json::Value &value, std::string &out)
+{
+  static thread_local JsonWriter writer;
+
+  writer.write (value, out);
+}
+
+const Json::Value &
+getMember (const Json::Value &value, const std::string &name)
+{
+  if (!value.isObject () ) {
+    return Json::Value::null;
+  }
+
+  const Json::Value *member = value.find (name.data (),
+                                          name.data () + name.size () );
+
+  return member != nullptr ? *member : Json::Value::null;
+}
+
+bool
+tryGetValue (const Json::Value &value, const std::string &name,
+             std::string &result)
+{
+  const Json::Value &member = getMember (value, name);
+
+  if (member.isNull () || member.isObject () || member.isArray () ) {
+    return false;
+  }
+
+  result = member.asString ();
+
+  return true;
+}
+
+bool
+tryGetValue (const Json::Value &value, const std::string &name, bool &result)
+{
+  const Json::Value &member = getMember (value, name);
+
+  if (!member.isBool () && !member.isNumeric () ) {
+    return false;
+  }
+
+  result = member.asBool ();
+
+  return true;
+}
+
+bool
+tryGetValue (const Json::Value &value, const std::string &name, int &result)
+{
+  const Json::Value &member = getMember (value, name);
+
+  if (!member.isConvertibleTo (Json::intValue) || !member.isNumeric () ) {
+    return false;
+  }
+
+  result = member.asInt ();
+
+  return true;
+}
+
+} // kurento
@@ -0,0 +1,61 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __JSON_UTILS_H__
+#define __JSON_UTILS_H__
+
+#include <string>
+
+#include <json/json.h>
+
+namespace kurento
+{
+
+/*
+ * Non-throwing counterparts of JsonRpc::getValue, for optional parameters.
+ *
+ * They return false, leaving the output untouched, when the member does not
+ * exist or cannot be converted to the requested type. Conversions follow the
+ * JsonRpc utilities: numbers and booleans are accepted as strings, and
+ * numbers as booleans.
+ */
+bool tryGetValue (const Json::Value &value, const std::string &name,
+                  std::string &result);
+bool tryGetValue (const Json::Value &value, const std::string &name,
+                  bool &result);
+bool tryGetValue (const Json::Value &value, const std::string &name,
+                  int &result);
+
+/*
+ * Returns the member without copying it, or Json::Value::null if value has
+ * no such member.
+ */
+const Json::Value &getMember (const Json::Value &value,
+                              const std::string &name);
+
+/*
+ * Serializes value without indentation into out, replacing its contents.
+ *
+ * The writer is created once per thread and writes straight into out, so
+ * reusing the same output string avoids any allocation once its capacity
+ * is large enough.
+ */
+void writeJson (const Json::Value &value, std::string &out);
+
+} // kurento
+
+#endif /* __JSON_UTILS_H__ */
@@ -17,8 +17,11 @@
 
 #include "RequestCache.hpp"
 #include <gst/gst.h>
+#include <config.h>
 
 #include <memory>
+#include <functional>
+#include <utility>
 
 #include "CacheEntry.hpp"
 
@@ -26,66 +29,236 @@
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "KurentoRequestCache"
 
+/* Next stuff is included to avoid problems with slots and lamdas */
+#include <type_traits>
+#include <sigc++/sigc++.h>
+#include <event2/event_struct.h>
+#if FIX_SIGC
+namespace sigc
+{
+template <typename Functor>
+struct functor_trait<Functor, false> {
+  typedef decltype (::sigc::mem_fun (std::declval<Functor &> (),
+                                     &Functor::operator() ) ) _intermediate;
+
+  typedef typename _intermediate::result_type result_type;
+  typedef Functor functor_type;
+};
+}
+#endif
+
+#define CACHE_SHARDS 16
+#define CACHE_TICK 250 /* milliseconds */
+
 namespace kurento
 {
 
-RequestCache::RequestCache (unsigned int timeout)
+RequestCache::RequestCache (unsigned int timeout, size_t maxBytes,
+                            size_t maxEntriesPerSession)
+  : maxBytes (maxBytes), maxEntriesPerSession (maxEntriesPerSession)
+{
+  start = std::chrono::steady_clock::now ();
+  timeoutTicks = (timeout + CACHE_TICK - 1) / CACHE_TICK;
+  maxShardBytes = maxBytes / CACHE_SHARDS;
+
+  if (maxBytes > 0 && maxShardBytes == 0) {
+    maxShardBytes = 1;
+  }
+
+  for (int i = 0; i < CACHE_SHARDS; i++) {
+    shards.emplace_back (new Shard (0) );
+  }
+
+  source = Glib::TimeoutSource::create (CACHE_TICK);
+  source->connect ([this] () -> bool {
+    return this->expire ();
+  });
+  source->attach();
+}
+
+RequestCache::~RequestCache()
+{
+  source->destroy();
+}
+
+RequestCache::Shard &
+RequestCache::getShard (const std::string &sessionId)
 {
-  this->timeout = timeout;
+  return *shards[std::hash<std::string>() (sessionId) % shards.size()];
 }
 
-RequestCache::~RequestCache() = default;
+uint64_t
+RequestCache::getCurrentTick ()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds> (
+           std::chrono::steady_clock::now () - start).count () / CACHE_TICK;
+}
 
+/* Must be called with the shard lock held */
 void
-RequestCache::addResponse (std::string sessionId, std::string requestId,
-                           Json::Value &response)
+RequestCache::remove (Shard &shard, const std::shared_ptr<CacheEntry> &entry)
 {
-  std::shared_ptr<CacheEntry> entry;
-  std::unique_lock<std::recursive_mutex> lock (mutex);
+  auto it1 = shard.cache.find (entry->getSessionId () );
+  if (it1 == shard.cache.end() ) {
+    return;
+  }
+
+  Session &session = it1->second;
+  auto it2 = session.requests.find (entry->getRequestId () );
+
+  /* The request may have been cached again with a newer entry */
+  if (it2 == session.requests.end() || it2->second.entry != entry) {
+    return;
+  }
+
+  shard.lru.erase (it2->second.lru);
+  session.lru.erase (it2->second.sessionLru);
+  shard.bytes -= entry->getSize ();
+  session.requests.erase (it2);
+
+  if (session.requests.empty() ) {
+    shard.cache.erase (it1);
+  }
+}
+
+bool
+RequestCache::expire ()
+{
+  uint64_t tick = getCurrentTick ();
+
+  for (auto &shard : shards) {
+    std::vector<std::shared_ptr<CacheEntry>> expired;
+    std::unique_lock<std::mutex> lock (shard->mutex);
+
+    shard->wheel.advance (tick, expired);
 
-  entry = std::make_shared<CacheEntry>(timeout, sessionId, requestId, response);
+    for (auto &entry : expired) {
+      remove (*shard, entry);
+    }
+
+    shard->expired += expired.size ();
 
-  cache[sessionId][requestId] = entry;
-  entry->signalTimeout.connect ([this, sessionId, requestId] () {
-    std::unique_lock<std::recursive_mutex> lock (this->mutex);
+    lock.unlock ();
 
-    auto it1 = this->cache.find (sessionId);
-    if (it1 == this->cache.end() ) {
-      return;
+    if (!expired.empty () ) {
+      GST_TRACE ("Expired %" G_GSIZE_FORMAT " cached responses",
+                 expired.size () );
     }
+  }
+
+  return true;
+}
+
+void
+RequestCache::addResponse (const std::string &sessionId,
+                           const std::string &requestId,
+                           std::shared_ptr<const std::string> response,
+                           const std::string &responseSessionId)
+{
+  std::shared_ptr<CacheEntry> entry;
+  Shard &shard = getShard (sessionId);
+
+  entry = std::make_shared<CacheEntry> (getCurrentTick () + timeoutTicks,
+                                        sessionId, requestId, std::move (response),
+                                        responseSessionId);
+
+  if (maxShardBytes > 0 && entry->getSize () > maxShardBytes) {
+    GST_DEBUG ("Response of %" G_GSIZE_FORMAT " bytes does not fit in cache",
+               entry->getSize () );
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock (shard.mutex);
+
+  Session &session = shard.cache[sessionId];
+  auto it = session.requests.find (requestId);
+
+  if (it != session.requests.end () ) {
+    remove (shard, it->second.entry);
+  }
 
-    auto &requestCache = it1->second;
-    auto it2 = requestCache.find (requestId);
-    if (it2 == requestCache.end() ) {
-      return;
+  /* remove() may have erased the session if it became empty */
+  Session &current = shard.cache[sessionId];
+  Node &node = current.requests[requestId];
+
+  shard.lru.push_front (entry);
+  current.lru.push_front (entry);
+  node.entry = entry;
+  node.lru = shard.lru.begin ();
+  node.sessionLru = current.lru.begin ();
+  shard.bytes += entry->getSize ();
+  shard.wheel.schedule (entry);
+
+  if (maxEntriesPerSession > 0) {
+    while (current.requests.size () > maxEntriesPerSession) {
+      std::shared_ptr<CacheEntry> victim = current.lru.back ();
+
+      remove (shard, victim);
+      shard.evictedBySessionQuota++;
     }
+  }
 
-    requestCache.erase (it2);
+  if (maxShardBytes > 0) {
+    while (shard.bytes > maxShardBytes) {
+      std::shared_ptr<CacheEntry> victim = shard.lru.back ();
 
-    if (requestCache.empty() ) {
-      this->cache.erase (it1);
+      remove (shard, victim);
+      shard.evicted++;
     }
-  });
+  }
 }
 
-Json::Value
-RequestCache::getCachedResponse (std::string sessionId, std::string requestId)
+std::shared_ptr<CacheEntry>
+RequestCache::getCachedResponse (const std::string &sessionId,
+                                 const std::string &requestId)
 {
-  std::unique_lock<std::recursive_mutex> lock (mutex);
+  Shard &shard = getShard (sessionId);
+  std::unique_lock<std::mutex> lock (shard.mutex);
 
-  auto it1 = cache.find (sessionId);
-  if (it1 == cache.end() ) {
+  auto it1 = shard.cache.find (sessionId);
+  if (it1 == shard.cache.end() ) {
+    shard.misses++;
     throw CacheException ("Session not cached");
   }
 
-  auto &requestCache = it1->second;
-  auto it2 = requestCache.find (requestId);
-  if (it2 == requestCache.end() ) {
+  Session &session = it1->second;
+  auto it2 = session.requests.find (requestId);
+  if (it2 == session.requests.end() ) {
+    shard.misses++;
     throw CacheException ("Request not cached");
   }
 
-  auto &cacheEntry = it2->second;
-  return cacheEntry->getResponse();
+  Node &node = it2->second;
+
+  shard.lru.splice (shard.lru.begin (), shard.lru, node.lru);
+  session.lru.splice (session.lru.begin (), session.lru, node.sessionLru);
+  shard.hits++;
+
+  return node.entry;
+}
+
+RequestCache::Stats
+RequestCache::getStats ()
+{
+  Stats stats;
+
+  stats.maxBytes = maxBytes;
+  stats.maxEntriesPerSession = maxEntriesPerSession;
+
+  for (auto &shard : shards) {
+    std::unique_lock<std::mutex> lock (shard->mutex);
+
+    stats.entries += shard->lru.size ();
+    stats.sessions += shard->cache.size ();
+    stats.bytes += shard->bytes;
+    stats.hits += shard->hits;
+    stats.misses += shard->misses;
+    stats.expired += shard->expired;
+    stats.evicted += shard->evicted;
+    stats.evictedBySessionQuota += shard->evictedBySessionQuota;
+  }
+
+  return stats;
 }
 
 RequestCache::StaticConstructor RequestCache::staticConstructor;
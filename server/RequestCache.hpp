@@ -19,35 +19,99 @@
 #define __REQUEST_CACHE_H__
 
 #include <memory>
-#include <map>
+#include <unordered_map>
+#include <list>
 #include <mutex>
+#include <chrono>
+#include <vector>
 
-#include <json/json.h>
+#include <glibmm.h>
+
+#include "TimerWheel.hpp"
 
 namespace kurento
 {
 
 class CacheEntry;
 
+/*
+ * Responses are stored in a fixed number of shards, selected by hashing the
+ * sessionId, each one protected by its own lock. Expiration is driven by a
+ * single main loop timer that advances the TimerWheel of every shard.
+ *
+ * Memory is bounded by maxBytes, split evenly among the shards, and by
+ * maxEntriesPerSession. When a limit is exceeded, the least recently used
+ * entries (of the shard or of the session, respectively) are evicted.
+ * A limit of 0 means unlimited.
+ */
 class RequestCache
 {
 public:
-  RequestCache (unsigned int timeout);
-  void addResponse (std::string sessionId, std::string requestId,
-                    Json::Value &response);
-  Json::Value getCachedResponse (std::string sessionId, std::string requestId);
+  struct Stats {
+    size_t entries = 0;
+    size_t sessions = 0;
+    size_t bytes = 0;
+    size_t maxBytes = 0;
+    size_t maxEntriesPerSession = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t expired = 0;
+    uint64_t evicted = 0;
+    uint64_t evictedBySessionQuota = 0;
+  };
+
+  RequestCache (unsigned int timeout, size_t maxBytes = 0,
+                size_t maxEntriesPerSession = 0);
+  void addResponse (const std::string &sessionId, const std::string &requestId,
+                    std::shared_ptr<const std::string> response,
+                    const std::string &responseSessionId);
+  std::shared_ptr<CacheEntry> getCachedResponse (const std::string &sessionId,
+      const std::string &requestId);
+  Stats getStats ();
   ~RequestCache ();
 
 private:
-  std::map<
-      std::string,  // Session ID
-      std::map<
-          std::string,  // Request ID
-          std::shared_ptr<CacheEntry>
-      >
-  > cache;
-  std::recursive_mutex mutex;
-  unsigned int timeout;
+  typedef std::list<std::shared_ptr<CacheEntry>> LruList;
+
+  struct Node {
+    std::shared_ptr<CacheEntry> entry;
+    LruList::iterator lru;        // Position in the shard LRU list
+    LruList::iterator sessionLru; // Position in the session LRU list
+  };
+
+  struct Session {
+    std::unordered_map<std::string, Node> requests; // By Request ID
+    LruList lru;
+  };
+
+  struct Shard {
+    Shard (uint64_t tick) : wheel (tick) {}
+
+    std::unordered_map<std::string, Session> cache; // By Session ID
+    LruList lru;
+    size_t bytes = 0;
+    TimerWheel wheel;
+    std::mutex mutex;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t expired = 0;
+    uint64_t evicted = 0;
+    uint64_t evictedBySessionQuota = 0;
+  };
+
+  Shard &getShard (const std::string &sessionId);
+  uint64_t getCurrentTick ();
+  bool expire ();
+  void remove (Shard &shard, const std::shared_ptr<CacheEntry> &entry);
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::chrono::steady_clock::time_point start;
+  Glib::RefPtr<Glib::TimeoutSource> source;
+  uint64_t timeoutTicks;
+  size_t maxBytes;
+  size_t maxShardBytes;
+  size_t maxEntriesPerSession;
 
   class StaticConstructor
   {
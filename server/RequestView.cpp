@@ -0,0 +1,119 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "RequestView.hpp"
+#include "JsonUtils.hpp"
+#include "CborUtils.hpp"
+#include <jsonrpc/JsonRpcConstants.hpp>
+
+#include <memory>
+
+#define SESSION_ID "sessionId"
+#define OBJECT "object"
+#define OPERATION "operation"
+
+namespace kurento
+{
+
+static Json::CharReader &
+getReader ()
+{
+  /* CharReader instances are not thread-safe, keep one per thread */
+  static thread_local std::unique_ptr<Json::CharReader> reader;
+
+  if (!reader) {
+    Json::CharReaderBuilder builder;
+
+    builder["collectComments"] = false;
+    reader.reset (builder.newCharReader () );
+  }
+
+  return *reader;
+}
+
+bool
+RequestView::parse (const std::string &message)
+{
+  const char *begin = message.data ();
+
+  if (!getReader ().parse (begin, begin + message.size (), &request,
+                           nullptr) ) {
+    return false;
+  }
+
+  index ();
+
+  return true;
+}
+
+bool
+RequestView::parseCbor (const std::string &message)
+{
+  if (!readCbor (message, request) ) {
+    return false;
+  }
+
+  index ();
+
+  return true;
+}
+
+void
+RequestView::assign (Json::Value &value)
+{
+  request.swap (value);
+  index ();
+}
+
+void
+RequestView::index ()
+{
+  idFound = tryGetValue (request, JSON_RPC_ID, id);
+  tryGetValue (request, JSON_RPC_METHOD, method);
+
+  const Json::Value &params = getParams ();
+
+  sessionIdFound = tryGetValue (params, SESSION_ID, sessionId);
+  tryGetValue (params, OBJECT, object);
+  tryGetValue (params, OPERATION, operation);
+}
+
+const Json::Value &
+RequestView::getParams () const
+{
+  return getMember (request, JSON_RPC_PARAMS);
+}
+
+void
+RequestView::injectSessionId (const std::string &sessionId)
+{
+  if (sessionIdFound || !request.isObject () ) {
+    return;
+  }
+
+  Json::Value &params = request[JSON_RPC_PARAMS];
+
+  if (!params.isNull () && !params.isObject () ) {
+    return;
+  }
+
+  params[SESSION_ID] = sessionId;
+  this->sessionId = sessionId;
+  sessionIdFound = true;
+}
+
+} // kurento
@@ -0,0 +1,116 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __REQUEST_VIEW_H__
+#define __REQUEST_VIEW_H__
+
+#include <string>
+
+#include <json/json.h>
+
+namespace kurento
+{
+
+/*
+ * JSON-RPC request parsed once, with the fields needed before and after
+ * dispatching it extracted in a single pass over the top level members.
+ *
+ * Missing or malformed optional fields are reported through the has*()
+ * methods, never with exceptions.
+ */
+class RequestView
+{
+public:
+  RequestView () = default;
+
+  /* Returns false if the message is not valid JSON */
+  bool parse (const std::string &message);
+
+  /* Returns false if the message is not valid CBOR */
+  bool parseCbor (const std::string &message);
+
+  /* Takes an already decoded request, such as an entry of a batch */
+  void assign (Json::Value &value);
+
+  /* Adds sessionId to the params, unless it already has one */
+  void injectSessionId (const std::string &sessionId);
+
+  const Json::Value &getRequest () const
+  {
+    return request;
+  }
+
+  Json::Value &getRequest ()
+  {
+    return request;
+  }
+
+  bool hasId () const
+  {
+    return idFound;
+  }
+
+  bool hasSessionId () const
+  {
+    return sessionIdFound;
+  }
+
+  const std::string &getId () const
+  {
+    return id;
+  }
+
+  const std::string &getMethod () const
+  {
+    return method;
+  }
+
+  const std::string &getSessionId () const
+  {
+    return sessionId;
+  }
+
+  const std::string &getObject () const
+  {
+    return object;
+  }
+
+  const std::string &getOperation () const
+  {
+    return operation;
+  }
+
+  /* Returns Json::Value::null if the request has no params */
+  const Json::Value &getParams () const;
+
+private:
+  void index ();
+
+  Json::Value request;
+
+  bool idFound = false;
+  bool sessionIdFound = false;
+  std::string id;
+  std::string method;
+  std::string sessionId;
+  std::string object;
+  std::string operation;
+};
+
+} // kurento
+
+#endif /* __REQUEST_VIEW_H__ */
@@ -18,9 +18,19 @@
 #include "ResourceManager.hpp"
 #include <gst/gst.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <KurentoException.hpp>
 #include <MediaSet.hpp>
 
@@ -28,9 +38,45 @@
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "KurentoResourceManager"
 
+/* Samples above this ratio of the limit are measured again when checked */
+#define RESOURCE_RECHECK_RATIO 0.9f
+
+#define LIMITS_REFRESH_PERIOD std::chrono::seconds (10)
+#define CGROUP_FILE "/proc/self/cgroup"
+#define CGROUP_MOUNT "/sys/fs/cgroup"
+
 namespace kurento
 {
 
+/* Last values taken by the sampler, -1 when it is not running */
+static std::atomic<long int> sampledThreads{-1};
+static std::atomic<long int> sampledOpenFiles{-1};
+static std::atomic<long int> sampledMemory{-1};
+/* Fraction of the available CPUs used in the last sampling period */
+static std::atomic<double> sampledCpuLoad{-1};
+/* Number of samples taken, 0 when the sampler is not running */
+static std::atomic<uint64_t> sampleCount{};
+static std::atomic<long int> samplingPeriodMs{};
+
+/* Current limits, refreshed every LIMITS_REFRESH_PERIOD */
+static std::atomic<rlim_t> maxThreadsLimit{};
+static std::atomic<rlim_t> maxOpenFilesLimit{};
+static std::atomic<rlim_t> maxMemoryLimit{};
+static std::atomic<double> cpuLimit{};
+static std::atomic<std::chrono::steady_clock::rep> limitsRefreshTime{};
+
+static std::string cgroupRoot;
+static std::mutex cgroupRootMutex;
+
+/* Only used by the thread taking samples */
+static std::chrono::microseconds lastCpuTime;
+static std::chrono::steady_clock::time_point lastSampleTime;
+
+static std::mutex samplerMutex;
+static std::condition_variable samplerCond;
+static std::thread samplerThread;
+static bool samplerRunning = false;
+
 static long int
 get_int (std::string &str, char sep, int nToken)
 {
@@ -63,23 +109,213 @@ getNumberOfThreads ()
   return get_int (stat, ' ', 19);
 }
 
-rlim_t
-getMaxThreads ()
+void
+setCgroupRoot (const std::string &root)
+{
+  std::unique_lock<std::mutex> lock (cgroupRootMutex);
+
+  cgroupRoot = root;
+  limitsRefreshTime = 0;
+}
+
+/* Directory of the cgroup v2 of the process, empty if not available */
+static std::string
+getCgroupDir (const std::string &root)
 {
-  static rlim_t limit = 0;
+  std::ifstream cgroup_file (root + CGROUP_FILE);  // `man cgroups`
+  std::string line;
 
-  if (limit == 0) {
-    struct rlimit limits;
-    getrlimit (RLIMIT_NPROC, &limits);
+  while (std::getline (cgroup_file, line) ) {
+    /* The unified hierarchy has id 0 and no controllers */
+    if (line.compare (0, 3, "0::") == 0) {
+      std::string path = root + CGROUP_MOUNT + line.substr (3);
 
-    limit = limits.rlim_cur;
+      while (!path.empty () && path.back () == '/') {
+        path.pop_back ();
+      }
+
+      return path;
+    }
+  }
+
+  return "";
+}
+
+/* Lowest value of a cgroup file up the hierarchy, as every ancestor limits
+ * its descendants. Returns RLIM_INFINITY if no cgroup sets a limit */
+template <typename Parse>
+static double
+getCgroupLimit (const std::string &mount, const std::string &cgroupDir,
+                const std::string &file, Parse parse)
+{
+  double limit = RLIM_INFINITY;
+  std::string dir = cgroupDir;
+
+  while (dir.size () >= mount.size () ) {
+    std::ifstream limit_file (dir + "/" + file);
+    std::string line;
+
+    if (std::getline (limit_file, line) ) {
+      limit = std::min (limit, parse (line) );
+    }
+
+    if (dir.size () == mount.size () ) {
+      break;
+    }
+
+    dir = dir.substr (0, dir.rfind ('/') );
   }
 
   return limit;
 }
 
+/* Value of files like pids.max or memory.max: a number or "max" */
+static double
+parseCgroupValue (const std::string &line)
+{
+  if (line.compare (0, 3, "max") == 0) {
+    return RLIM_INFINITY;
+  }
+
+  return strtod (line.c_str (), nullptr);
+}
+
+/* Number of CPUs from cpu.max: "$MAX $PERIOD", where $MAX may be "max" */
+static double
+parseCgroupCpus (const std::string &line)
+{
+  std::istringstream values (line);
+  std::string quota;
+  double period = 0;
+
+  values >> quota >> period;
+
+  if (quota == "max" || period <= 0) {
+    return RLIM_INFINITY;
+  }
+
+  return strtod (quota.c_str (), nullptr) / period;
+}
+
+static rlim_t
+toLimit (double value)
+{
+  return value >= (double) RLIM_INFINITY ? RLIM_INFINITY : (rlim_t) value;
+}
+
+static std::string
+limitToString (rlim_t limit)
+{
+  return limit == RLIM_INFINITY ? "unlimited" : std::to_string (limit);
+}
+
+/*
+ * Limits are read again periodically, so containers resized while running
+ * are taken into account. The binding limit is the lowest of the process
+ * rlimit, the system resources and the cgroup v2 limits.
+ */
+static void
+refreshLimits ()
+{
+  std::string root;
+  struct rlimit limits;
+  rlim_t maxThreads, maxOpenFiles, maxMemory;
+  double cpus;
+
+  getrlimit (RLIMIT_NPROC, &limits);
+  maxThreads = limits.rlim_cur;
+  getrlimit (RLIMIT_NOFILE, &limits);
+  maxOpenFiles = limits.rlim_cur;
+  maxMemory = (rlim_t) sysconf (_SC_PHYS_PAGES) * sysconf (_SC_PAGESIZE);
+  cpus = std::max (sysconf (_SC_NPROCESSORS_ONLN), 1L);
+
+  {
+    std::unique_lock<std::mutex> lock (cgroupRootMutex);
+
+    root = cgroupRoot;
+  }
+
+  std::string mount = root + CGROUP_MOUNT;
+  std::string cgroupDir = getCgroupDir (root);
+
+  if (!cgroupDir.empty () ) {
+    maxThreads = std::min (maxThreads, toLimit (getCgroupLimit (mount,
+                           cgroupDir, "pids.max", parseCgroupValue) ) );
+    maxMemory = std::min (maxMemory, toLimit (getCgroupLimit (mount,
+                          cgroupDir, "memory.max", parseCgroupValue) ) );
+    cpus = std::min (cpus, getCgroupLimit (mount, cgroupDir, "cpu.max",
+                     parseCgroupCpus) );
+  }
+
+  if (maxThreads != maxThreadsLimit || maxOpenFiles != maxOpenFilesLimit
+      || maxMemory != maxMemoryLimit || cpus != cpuLimit) {
+    GST_INFO ("Resource limits: %s threads, %s files, %s bytes of memory, "
+              "%.2f CPUs", limitToString (maxThreads).c_str (),
+              limitToString (maxOpenFiles).c_str (), limitToString (maxMemory).c_str (),
+              cpus);
+  }
+
+  maxThreadsLimit = maxThreads;
+  maxOpenFilesLimit = maxOpenFiles;
+  maxMemoryLimit = maxMemory;
+  cpuLimit = cpus;
+  limitsRefreshTime = std::chrono::steady_clock::now ().time_since_epoch ().count ();
+}
+
+static void
+ensureLimits ()
+{
+  std::chrono::steady_clock::duration elapsed =
+    std::chrono::steady_clock::now ().time_since_epoch () -
+    std::chrono::steady_clock::duration (limitsRefreshTime.load () );
+
+  if (limitsRefreshTime == 0 || elapsed >= LIMITS_REFRESH_PERIOD) {
+    refreshLimits ();
+  }
+}
+
+rlim_t
+getMaxThreads ()
+{
+  ensureLimits ();
+
+  return maxThreadsLimit;
+}
+
+rlim_t
+getMaxOpenFiles ()
+{
+  ensureLimits ();
+
+  return maxOpenFilesLimit;
+}
+
+rlim_t
+getMaxMemory ()
+{
+  ensureLimits ();
+
+  return maxMemoryLimit;
+}
+
+double
+getCpuLimit ()
+{
+  ensureLimits ();
+
+  return cpuLimit;
+}
+
+/* A sample plus the extra usage is trusted while it is clearly below the
+ * limit. Without a sample (-1) usage is always measured */
+static bool
+isSampleBelowLimit (long int sample, long int extra, rlim_t limit)
+{
+  return sample >= 0 && sample + extra < limit * RESOURCE_RECHECK_RATIO;
+}
+
 static void
-checkThreads (float limit_percent)
+checkThreads (float limit_percent, long int extra)
 {
   const rlim_t maxThreads = getMaxThreads ();
   if (maxThreads <= 0 || maxThreads == RLIM_INFINITY) {
@@ -87,7 +323,12 @@ checkThreads (float limit_percent)
   }
 
   const rlim_t maxThreadsKms = (rlim_t)(maxThreads * limit_percent);
-  const rlim_t nThreads = (rlim_t)getNumberOfThreads ();
+
+  if (isSampleBelowLimit (sampledThreads, extra, maxThreadsKms) ) {
+    return;
+  }
+
+  const rlim_t nThreads = (rlim_t) (getNumberOfThreads () + extra);
 
   if (nThreads > maxThreadsKms) {
     std::ostringstream oss;
@@ -103,32 +344,31 @@ checkThreads (float limit_percent)
   }
 }
 
-rlim_t
-getMaxOpenFiles ()
-{
-  static rlim_t limit = 0;
-
-  if (limit == 0) {
-    struct rlimit limits;
-    getrlimit (RLIMIT_NOFILE, &limits);
-
-    limit = limits.rlim_cur;
-  }
-
-  return limit;
-}
-
 static long int
 getNumberOfOpenFiles ()
 {
   long int openFiles = 0;
+  struct stat st;
   DIR *d;
   struct dirent *dir;
 
+  /* Since Linux 6.2 the size of the directory is the number of open files,
+   * which is much cheaper than reading it */
+  if (stat ("/proc/self/fd", &st) == 0 && st.st_size > 0) {
+    return st.st_size;
+  }
+
   d = opendir ("/proc/self/fd");
 
+  if (d == nullptr) {
+    return 0;
+  }
+
+  /* Counted like the size above, without "." and ".." */
   while ((dir = readdir(d)) != nullptr) {
-    openFiles ++;
+    if (dir->d_name[0] != '.') {
+      openFiles ++;
+    }
   }
 
   closedir (d);
@@ -137,7 +377,7 @@ getNumberOfOpenFiles ()
 }
 
 static void
-checkOpenFiles (float limit_percent)
+checkOpenFiles (float limit_percent, long int extra)
 {
   const rlim_t maxOpenFiles = getMaxOpenFiles ();
   if (maxOpenFiles <= 0 || maxOpenFiles == RLIM_INFINITY) {
@@ -145,7 +385,12 @@ checkOpenFiles (float limit_percent)
   }
 
   const rlim_t maxOpenFilesKms = (rlim_t)(maxOpenFiles * limit_percent);
-  const rlim_t nOpenFiles = (rlim_t)getNumberOfOpenFiles ();
+
+  if (isSampleBelowLimit (sampledOpenFiles, extra, maxOpenFilesKms) ) {
+    return;
+  }
+
+  const rlim_t nOpenFiles = (rlim_t) (getNumberOfOpenFiles () + extra);
 
   if (nOpenFiles > maxOpenFilesKms) {
     std::ostringstream oss;
@@ -161,11 +406,235 @@ checkOpenFiles (float limit_percent)
   }
 }
 
+/* Resident memory, in bytes */
+static long int
+getMemoryUsage ()
+{
+  long int size = 0, resident = 0;
+  FILE *statm = fopen ("/proc/self/statm", "r");  // `man proc`
+
+  if (statm == nullptr) {
+    return 0;
+  }
+
+  if (fscanf (statm, "%ld %ld", &size, &resident) != 2) {
+    resident = 0;
+  }
+
+  fclose (statm);
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+static void
+checkMemory (float limit_percent, long int extra)
+{
+  const rlim_t maxMemory = getMaxMemory ();
+  if (maxMemory <= 0 || maxMemory == RLIM_INFINITY) {
+    return;
+  }
+
+  const rlim_t maxMemoryKms = (rlim_t)(maxMemory * limit_percent);
+
+  if (isSampleBelowLimit (sampledMemory, extra, maxMemoryKms) ) {
+    return;
+  }
+
+  const rlim_t memory = (rlim_t) (getMemoryUsage () + extra);
+
+  if (memory > maxMemoryKms) {
+    std::ostringstream oss;
+    oss << "Reached KMS memory limit: " << maxMemoryKms << " bytes";
+    std::string exMessage = oss.str();
+
+    oss << " (system max: " << maxMemory << " bytes)";
+    std::string logMessage = oss.str();
+
+    GST_WARNING ("%s", logMessage.c_str());
+    throw KurentoException (NOT_ENOUGH_RESOURCES, exMessage);
+  }
+}
+
+ResourceUsage
+getResourceUsage ()
+{
+  ResourceUsage usage;
+
+  usage.threads = sampledThreads;
+  usage.openFiles = sampledOpenFiles;
+  usage.memory = sampledMemory;
+
+  if (usage.threads < 0) {
+    usage.threads = getNumberOfThreads ();
+  }
+
+  if (usage.openFiles < 0) {
+    usage.openFiles = getNumberOfOpenFiles ();
+  }
+
+  if (usage.memory < 0) {
+    usage.memory = getMemoryUsage ();
+  }
+
+  return usage;
+}
+
+ResourceUsage
+measureResourceUsage ()
+{
+  ResourceUsage usage;
+
+  usage.threads = getNumberOfThreads ();
+  usage.openFiles = getNumberOfOpenFiles ();
+  usage.memory = getMemoryUsage ();
+
+  return usage;
+}
+
+uint64_t
+getResourceSampleCount ()
+{
+  return sampleCount;
+}
+
+std::chrono::milliseconds
+getResourceSamplingPeriod ()
+{
+  return std::chrono::milliseconds (samplingPeriodMs.load () );
+}
+
+double
+getCpuLoad ()
+{
+  return sampledCpuLoad;
+}
+
+/* Ratio of the usage to the limit of the most used resource */
+double
+getLoadScore ()
+{
+  ResourceUsage usage = getResourceUsage ();
+  double score = std::max (getCpuLoad (), 0.0);
+  const rlim_t maxThreads = getMaxThreads ();
+  const rlim_t maxOpenFiles = getMaxOpenFiles ();
+  const rlim_t maxMemory = getMaxMemory ();
+
+  if (maxThreads > 0 && maxThreads != RLIM_INFINITY) {
+    score = std::max (score, (double) usage.threads / maxThreads);
+  }
+
+  if (maxOpenFiles > 0 && maxOpenFiles != RLIM_INFINITY) {
+    score = std::max (score, (double) usage.openFiles / maxOpenFiles);
+  }
+
+  if (maxMemory > 0 && maxMemory != RLIM_INFINITY) {
+    score = std::max (score, (double) usage.memory / maxMemory);
+  }
+
+  return score;
+}
+
+/* User and system CPU time used by the process */
+static std::chrono::microseconds
+getCpuTime ()
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  return std::chrono::seconds (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         std::chrono::microseconds (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+static void
+takeSample ()
+{
+  std::chrono::microseconds cpuTime = getCpuTime ();
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now ();
+
+  if (sampleCount > 0) {
+    std::chrono::duration<double> cpu = cpuTime - lastCpuTime;
+    std::chrono::duration<double> elapsed = now - lastSampleTime;
+
+    if (elapsed.count () > 0) {
+      sampledCpuLoad = cpu.count () / elapsed.count () / getCpuLimit ();
+    }
+  }
+
+  lastCpuTime = cpuTime;
+  lastSampleTime = now;
+
+  /* Refreshed here so that checks rarely need to */
+  ensureLimits ();
+
+  sampledThreads = getNumberOfThreads ();
+  sampledOpenFiles = getNumberOfOpenFiles ();
+  sampledMemory = getMemoryUsage ();
+  sampleCount++;
+}
+
+static void
+sampleResources (std::chrono::milliseconds period)
+{
+  std::unique_lock<std::mutex> lock (samplerMutex);
+
+  while (!samplerCond.wait_for (lock, period, [] () {
+  return !samplerRunning;
+}) ) {
+    lock.unlock ();
+    takeSample ();
+    lock.lock ();
+  }
+
+  sampledThreads = -1;
+  sampledOpenFiles = -1;
+  sampledMemory = -1;
+  sampledCpuLoad = -1;
+  sampleCount = 0;
+  samplingPeriodMs = 0;
+}
+
+void
+startResourceSampler (std::chrono::milliseconds period)
+{
+  std::unique_lock<std::mutex> lock (samplerMutex);
+
+  if (samplerRunning) {
+    return;
+  }
+
+  /* First sample taken before returning, so it is used from now on */
+  takeSample ();
+
+  samplingPeriodMs = period.count ();
+  samplerRunning = true;
+  samplerThread = std::thread (sampleResources, period);
+
+  GST_INFO ("Sampling resource usage every %ld ms", (long) period.count () );
+}
+
+void
+stopResourceSampler ()
+{
+  std::unique_lock<std::mutex> lock (samplerMutex);
+
+  if (!samplerRunning) {
+    return;
+  }
+
+  samplerRunning = false;
+  samplerCond.notify_all ();
+  lock.unlock ();
+
+  samplerThread.join ();
+}
+
 void
-checkResources (float limit_percent)
+checkResources (float limit_percent, const ResourceUsage &extra)
 {
-  checkThreads (limit_percent);
-  checkOpenFiles (limit_percent);
+  checkThreads (limit_percent, extra.threads);
+  checkOpenFiles (limit_percent, extra.openFiles);
+  checkMemory (limit_percent, extra.memory);
 }
 
 void killServerOnLowResources (float limit_percent)
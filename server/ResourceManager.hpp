@@ -22,15 +22,63 @@
 // (see `man sys_resource.h`)
 #include <sys/resource.h>
 
+#include <chrono>
+#include <cstdint>
+#include <string>
+
 namespace kurento
 {
 
 static const float DEFAULT_RESOURCE_LIMIT_PERCENT = 0.80f;
+static const std::chrono::milliseconds DEFAULT_RESOURCE_SAMPLING_PERIOD (1000);
+
+struct ResourceUsage {
+  long int threads;
+  long int openFiles;
+  /* Resident memory, in bytes */
+  long int memory;
+};
 
 rlim_t getMaxThreads ();
 rlim_t getMaxOpenFiles ();
+/* Physical memory, in bytes */
+rlim_t getMaxMemory ();
+
+/* Last usage taken by the sampler, or measured now if it is not running */
+ResourceUsage getResourceUsage ();
+ResourceUsage measureResourceUsage ();
+/* Number of samples taken so far, 0 if the sampler is not running */
+uint64_t getResourceSampleCount ();
+/* Period of the sampler, 0 if it is not running */
+std::chrono::milliseconds getResourceSamplingPeriod ();
+
+/* Directory taken as "/" to find the cgroup of the process, in
+ * /proc/self/cgroup, and its limits, under /sys/fs/cgroup. Empty for the
+ * real ones. Limits are read again on the next check */
+void setCgroupRoot (const std::string &root);
+
+/* Number of CPUs available to the process */
+double getCpuLimit ();
+/* CPU used by the process in the last sampling period, as a fraction of
+ * getCpuLimit; negative if unknown, as when the sampler is not running */
+double getCpuLoad ();
+/* Highest ratio of usage to limit among CPU, threads, open files and memory:
+ * 0 when idle, 1 when a resource is exhausted */
+double getLoadScore ();
+
+/*
+ * Resource usage is sampled periodically by a background thread, so that
+ * checkResources only reads the last sample. Well below the limit, checks
+ * are made against a sample up to a period old, so a burst between samples
+ * is not seen until the next one; close to the limit usage is measured again
+ * on every check.
+ */
+void startResourceSampler (std::chrono::milliseconds period);
+void stopResourceSampler ();
 
-void checkResources (float limit_percent);
+/* Throws NOT_ENOUGH_RESOURCES if the current usage plus extra is above
+ * limit_percent of the limits */
+void checkResources (float limit_percent, const ResourceUsage &extra = {0, 0, 0});
 
 void killServerOnLowResources (float limit_percent);
 
@@ -28,11 +28,16 @@
 #include <jsonrpc/JsonFixes.hpp>
 
 #include <sstream>
+#include <mutex>
+#include <exception>
+#include <algorithm>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
 #include "modules.hpp"
+#include "StartupProfile.hpp"
+#include "AdmissionControl.hpp"
 #include <version.hpp>
 #include <ServerManagerImpl.hpp>
 #include <ServerInfo.hpp>
@@ -41,6 +46,12 @@
 #include <UUIDGenerator.hpp>
 
 #include <ResourceManager.hpp>
+#include "CacheEntry.hpp"
+#include "RequestView.hpp"
+#include "JsonUtils.hpp"
+#include "CborUtils.hpp"
+#include "TaskGroup.hpp"
+#include "Transaction.hpp"
 
 #define GST_CAT_DEFAULT kurento_server_methods
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
@@ -53,11 +64,16 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define TYPE "type"
 #define QUALIFIED_TYPE "qualifiedType"
 #define HIERARCHY "hierarchy"
+#define TEMPLATE "template"
+#define PARAMETERS "parameters"
+#define NAME "name"
 
 #define REQUEST_TIMEOUT 20000 /* 20 seconds */
+#define REQUEST_CACHE_MAX_BYTES (64 * 1024 * 1024) /* 64 MiB */
+#define REQUEST_CACHE_MAX_ENTRIES_PER_SESSION 1000
+#define PREPARED_TRANSACTIONS_MAX 1000
 
 static const std::string KURENTO_MODULES_PATH = "KURENTO_MODULES_PATH";
-static const std::string NEW_REF = "newref:";
 
 namespace kurento
 {
@@ -123,6 +139,8 @@ ServerMethods::ServerMethods (const boost::property_tree::ptree &config) :
   }
 
   capabilities.emplace_back("transactions");
+  capabilities.emplace_back("preparedTransactions");
+  capabilities.emplace_back("stats");
 
   serverInfo =
       std::make_shared<ServerInfo>(version, modules, type, capabilities);
@@ -132,20 +150,25 @@ ServerMethods::ServerMethods (const boost::property_tree::ptree &config) :
   MediaSet::getMediaSet ()->setServerManager (std::dynamic_pointer_cast
       <ServerManagerImpl> (serverManager) );
 
-  cache = std::make_shared<RequestCache>(REQUEST_TIMEOUT);
-
   if (!disableRequestCache) {
-    handler.setPreProcess (std::bind (&ServerMethods::preProcess, this,
-                                      std::placeholders::_1,
-                                      std::placeholders::_2) );
-    handler.setPostProcess (std::bind (&ServerMethods::postProcess, this,
-                                       std::placeholders::_1,
-                                       std::placeholders::_2) );
-    GST_INFO ("RPC Request Cache is ENABLED");
+    size_t maxBytes = config.get<size_t> (
+                        "mediaServer.resources.requestCacheMaxBytes", REQUEST_CACHE_MAX_BYTES);
+    size_t maxEntriesPerSession = config.get<size_t> (
+                                    "mediaServer.resources.requestCacheMaxEntriesPerSession",
+                                    REQUEST_CACHE_MAX_ENTRIES_PER_SESSION);
+
+    cache = std::make_shared<RequestCache> (REQUEST_TIMEOUT, maxBytes,
+            maxEntriesPerSession);
+    GST_INFO ("RPC Request Cache is ENABLED (max %" G_GSIZE_FORMAT
+              " bytes, %" G_GSIZE_FORMAT " entries per session)", maxBytes,
+              maxEntriesPerSession);
   } else {
     GST_INFO ("RPC Request Cache is DISABLED");
   }
 
+  admissionControl = std::make_shared<AdmissionControl> (resourceLimitPercent,
+                     config);
+
   handler.addMethod ("connect", std::bind (&ServerMethods::connect, this,
                      std::placeholders::_1,
                      std::placeholders::_2) );
@@ -178,11 +201,19 @@ ServerMethods::ServerMethods (const boost::property_tree::ptree &config) :
                      std::placeholders::_2) );
   handler.addMethod ("transaction", std::bind (&ServerMethods::transaction,
                      this, std::placeholders::_1, std::placeholders::_2) );
+  handler.addMethod ("prepareTransaction", std::bind (
+                       &ServerMethods::prepareTransaction, this, std::placeholders::_1,
+                       std::placeholders::_2) );
+  handler.addMethod ("releaseTransaction", std::bind (
+                       &ServerMethods::releaseTransaction, this, std::placeholders::_1,
+                       std::placeholders::_2) );
   handler.addMethod ("ping", std::bind (&ServerMethods::ping, this,
                                         std::placeholders::_1, std::placeholders::_2) );
   handler.addMethod ("closeSession", std::bind (&ServerMethods::closeSession,
                      this,
                      std::placeholders::_1, std::placeholders::_2) );
+  handler.addMethod ("stats", std::bind (&ServerMethods::stats, this,
+                                         std::placeholders::_1, std::placeholders::_2) );
 }
 
 ServerMethods::~ServerMethods() = default;
@@ -203,92 +234,185 @@ requireParams (const Json::Value &params)
 static bool
 getOrCreateSessionId (std::string &_sessionId, const Json::Value &params)
 {
-  try {
-    JsonRpc::getValue (params, SESSION_ID, _sessionId);
+  if (tryGetValue (params, SESSION_ID, _sessionId) ) {
     return true;
-  } catch (JsonRpc::CallException e) {
-    _sessionId = generateUUID ();
-    return false;
   }
+
+  _sessionId = generateUUID ();
+  return false;
 }
 
+/*
+ * SessionId to associate with the connection after processing a request:
+ * none for errors, the one in the result if any, or else the current one
+ */
 static std::string
-getSessionId (const Json::Value &resp)
+getResponseSessionId (const Json::Value &resp, const std::string &sessionId)
 {
-  std::string sessionId;
-
-  Json::Value result;
+  std::string newSessionId;
 
   if (resp.isMember (JSON_RPC_ERROR) ) {
     /* If response is an error do not return a sessionId */
-    return sessionId;
+    return newSessionId;
   }
 
-  JsonRpc::getValue (resp, JSON_RPC_RESULT, result);
-  JsonRpc::getValue (result, SESSION_ID, sessionId);
+  if (!resp.isMember (JSON_RPC_RESULT)
+      || !tryGetValue (resp[JSON_RPC_RESULT], SESSION_ID, newSessionId) ) {
+    /* We could not get some of the required parameters. Ignore */
+    newSessionId = sessionId;
+  }
 
-  return sessionId;
+  return newSessionId;
 }
 
+std::string
+ServerMethods::process (const std::string &requestStr, std::string &responseStr,
+                        std::string &sessionId)
+{
+  return dispatch (requestStr, responseStr, sessionId,
+                   ConnectionState::Encoding::JSON);
+}
 
-static void
-injectSessionId (Json::Value &req, const std::string &sessionId)
+std::string
+ServerMethods::process (const std::string &requestStr, std::string &responseStr,
+                        const std::shared_ptr<ConnectionState> &connection)
 {
-  try {
-    Json::Value params;
+  std::string sessionId = connection->getSessionId ();
 
-    params = req[JSON_RPC_PARAMS];
+  return dispatch (requestStr, responseStr, sessionId,
+                   connection->getEncoding () );
+}
 
-    try {
-      std::string oldSessionId;
-
-      JsonRpc::getValue (params, SESSION_ID, oldSessionId);
-    } catch (JsonRpc::CallException &e) {
-      // There is no sessionId, inject it
-      GST_TRACE ("Injecting sessionId %s", sessionId.c_str() );
-      params[SESSION_ID] = sessionId;
-      req[JSON_RPC_PARAMS] = params;
-    }
-  } catch (JsonRpc::CallException &ex) {
+std::string
+ServerMethods::dispatch (const std::string &requestStr,
+                         std::string &responseStr, std::string &sessionId,
+                         ConnectionState::Encoding encoding)
+{
+  RequestView request;
+  bool parsed = (encoding == ConnectionState::Encoding::CBOR) ?
+                request.parseCbor (requestStr) : request.parse (requestStr);
+
+  if (!parsed) {
+    throw JsonRpc::CallException (JsonRpc::ErrorCode::PARSE_ERROR, "Parse error.");
+  }
 
+  /* An empty batch is left to the handler, that rejects it as invalid */
+  if (request.getRequest ().isArray () && !request.getRequest ().empty () ) {
+    return dispatchBatch (request.getRequest (), responseStr, sessionId,
+                          encoding);
   }
+
+  return dispatchRequest (request, responseStr, sessionId, encoding);
 }
 
 std::string
-ServerMethods::process (const std::string &requestStr, std::string &responseStr,
-                        std::string &sessionId)
+ServerMethods::dispatchRequest (RequestView &request, std::string &responseStr,
+                                const std::string &sessionId, ConnectionState::Encoding encoding)
 {
   Json::Value response;
-  Json::Value request;
-  bool parse = false;
-  Json::Reader reader;
   std::string newSessionId;
 
-  parse = reader.parse (requestStr, request);
+  if (!sessionId.empty() ) {
+    request.injectSessionId (sessionId);
+  }
 
-  if (!parse) {
-    throw JsonRpc::CallException (JsonRpc::ErrorCode::PARSE_ERROR, "Parse error.");
+  if (cache && getCachedResponse (request, encoding, responseStr,
+                                  newSessionId) ) {
+    return newSessionId;
   }
 
-  if (!sessionId.empty() ) {
-    injectSessionId (request, sessionId);
+  handler.process (request.getRequest (), response);
+
+  newSessionId = getResponseSessionId (response, sessionId);
+
+  if (response != Json::Value::null) {
+    if (encoding == ConnectionState::Encoding::CBOR) {
+      writeCbor (response, responseStr);
+    } else {
+      writeJson (response, responseStr);
+    }
+
+    if (cache) {
+      addCachedResponse (request, encoding, response, responseStr, newSessionId);
+    }
   }
 
-  handler.process (request, response);
+  return newSessionId;
+}
 
-  try {
-    newSessionId = getSessionId (response);
-  } catch (JsonRpc::CallException &ex) {
-    /* We could not get some of the required parameters. Ignore */
-    newSessionId = sessionId;
+/*
+ * Entries of a JSON-RPC batch are independent, so they are processed
+ * concurrently on the executor. Each one goes through the same path as a
+ * single request, including the cache, and the combined response is built
+ * from their serialized responses, omitting those of notifications.
+ */
+std::string
+ServerMethods::dispatchBatch (Json::Value &batch, std::string &responseStr,
+                              const std::string &sessionId, ConnectionState::Encoding encoding)
+{
+  Json::ArrayIndex size = batch.size ();
+  std::vector<std::string> responses (size);
+  std::vector<std::string> newSessionIds (size);
+  std::string batchSessionId = sessionId;
+  std::string newSessionId;
+  Json::ArrayIndex first = 0;
+  size_t count = 0;
+  TaskGroup tasks (executor);
+
+  auto processEntry = [&] (Json::ArrayIndex i) {
+    RequestView request;
+
+    request.assign (batch[i]);
+    newSessionIds[i] = dispatchRequest (request, responses[i], batchSessionId,
+                                        encoding);
+  };
+
+  if (batchSessionId.empty () ) {
+    /* The first entry creates the session used by the rest, as it would
+     * happen when they are sent one by one */
+    processEntry (first++);
+    batchSessionId = newSessionIds[0];
   }
 
-  if (response != Json::Value::null) {
-    Json::StreamWriterBuilder writerFactory;
-    writerFactory["indentation"] = "";
-    responseStr = Json::writeString (writerFactory, response);
+  for (Json::ArrayIndex i = first; i < size; i++) {
+    tasks.run (std::bind (processEntry, i) );
   }
 
+  tasks.wait ();
+
+  responseStr.clear ();
+
+  for (Json::ArrayIndex i = 0; i < size; i++) {
+    if (!newSessionIds[i].empty () ) {
+      newSessionId = newSessionIds[i];
+    }
+
+    if (responses[i].empty () ) {
+      continue;
+    }
+
+    if (encoding == ConnectionState::Encoding::JSON) {
+      responseStr.append (count == 0 ? "[" : ",");
+    }
+
+    responseStr.append (responses[i]);
+    count++;
+  }
+
+  if (count == 0) {
+    /* Only notifications, nothing is returned */
+    responseStr.clear ();
+  } else if (encoding == ConnectionState::Encoding::CBOR) {
+    std::string header;
+
+    appendCborArrayHeader (count, header);
+    responseStr.insert (0, header);
+  } else {
+    responseStr.append ("]");
+  }
+
+  GST_DEBUG ("Processed batch of %u requests", size);
+
   return newSessionId;
 }
 
@@ -298,59 +422,71 @@ ServerMethods::keepAliveSession (const std::string &sessionId)
   MediaSet::getMediaSet()->keepAliveSession (sessionId);
 }
 
-bool
-ServerMethods::preProcess (const Json::Value &request, Json::Value &response)
+/* Responses are cached serialized, so each encoding has its own entries */
+static std::string
+getCacheId (const RequestView &request, ConnectionState::Encoding encoding)
 {
-  std::string sessionId;//   std::string resp;
-  std::string requestId;
-
-  try {
-    Json::Value params;
-
-    JsonRpc::getValue (request, JSON_RPC_ID, requestId);
-    JsonRpc::getValue (request, JSON_RPC_PARAMS, params);
-    JsonRpc::getValue (params, SESSION_ID, sessionId);
+  if (encoding == ConnectionState::Encoding::CBOR) {
+    return "cbor:" + request.getId ();
+  }
 
-    response = cache->getCachedResponse (sessionId, requestId);
+  return request.getId ();
+}
 
-    GST_DEBUG ("Cached response");
+bool
+ServerMethods::getCachedResponse (const RequestView &request,
+                                  ConnectionState::Encoding encoding, std::string &responseStr,
+                                  std::string &newSessionId)
+{
+  std::shared_ptr<CacheEntry> entry;
 
+  if (!request.hasId () || !request.hasSessionId () ) {
     return false;
-  } catch (...) {
+  }
+
+  try {
+    entry = cache->getCachedResponse (request.getSessionId (),
+                                      getCacheId (request, encoding) );
+  } catch (CacheException &e) {
     /* continue processing */
-    return true;
+    return false;
   }
+
+  GST_DEBUG ("Cached response");
+
+  responseStr = *entry->getResponse ();
+  newSessionId = entry->getResponseSessionId ();
+
+  return true;
 }
 
 void
-ServerMethods::postProcess (const Json::Value &request, Json::Value &response)
+ServerMethods::addCachedResponse (const RequestView &request,
+                                  ConnectionState::Encoding encoding, const Json::Value &response, const std::string &responseStr,
+                                  const std::string &newSessionId)
 {
   std::string sessionId;
-  std::string requestId;
-
-  try {
-    JsonRpc::getValue (request, JSON_RPC_ID, requestId);
 
-    try {
-      Json::Value result;
-
-      JsonRpc::getValue (response, JSON_RPC_RESULT, result);
-      JsonRpc::getValue (result, SESSION_ID, sessionId);
-    } catch (JsonRpc::CallException &ex) {
-      Json::Value params;
+  if (!request.hasId () ) {
+    return;
+  }
 
-      JsonRpc::getValue (request, JSON_RPC_PARAMS, params);
-      JsonRpc::getValue (params, SESSION_ID, sessionId);
+  if (!response.isMember (JSON_RPC_RESULT)
+      || !tryGetValue (response[JSON_RPC_RESULT], SESSION_ID, sessionId) ) {
+    if (!request.hasSessionId () ) {
+      /* We could not get some of the required parameters. Ignore */
+      return;
     }
 
-    /* CacheException will be triggered if this response is not cached */
-    cache->getCachedResponse (sessionId, requestId);
-  } catch (JsonRpc::CallException &e) {
-    /* We could not get some of the required parameters. Ignore */
-  } catch (CacheException &e) {
-    GST_LOG ("Caching: %s", response.toStyledString().c_str() );
-    cache->addResponse (sessionId, requestId, response);
+    sessionId = request.getSessionId ();
+  }
+
+  if (encoding == ConnectionState::Encoding::JSON) {
+    GST_LOG ("Caching: %s", responseStr.c_str() );
   }
+
+  cache->addResponse (sessionId, getCacheId (request, encoding),
+                      std::make_shared<const std::string> (responseStr), newSessionId);
 }
 
 void
@@ -575,7 +711,6 @@ ServerMethods::invoke (const Json::Value &params, Json::Value &response)
   std::shared_ptr<MediaObjectImpl> obj;
   std::string sessionId;
   std::string operation;
-  Json::Value operationParams;
   std::string objectId;
 
   requireParams (params);
@@ -583,11 +718,8 @@ ServerMethods::invoke (const Json::Value &params, Json::Value &response)
   JsonRpc::getValue (params, "operation", operation);
   JsonRpc::getValue (params, OBJECT, objectId);
 
-  try {
-    JsonRpc::getValue (params, "operationParams", operationParams);
-  } catch (JsonRpc::CallException e) {
-    /* operationParams is optional at this point */
-  }
+  /* operationParams is optional at this point */
+  const Json::Value &operationParams = getMember (params, "operationParams");
 
   getOrCreateSessionId (sessionId, params);
 
@@ -654,21 +786,18 @@ ServerMethods::create (const Json::Value &params,
 
   JsonRpc::getValue (params, TYPE, type);
 
-  try {
-    JsonRpc::getValue (params, SESSION_ID, sessionId);
-  } catch (JsonRpc::CallException e) {
-    sessionId = generateUUID ();
-  }
+  getOrCreateSessionId (sessionId, params);
 
   try {
     factory = moduleManager.getFactory (type);
 
-    checkResources (resourceLimitPercent);
+    AdmissionControl::Ticket ticket = admissionControl->admit (type);
 
     std::shared_ptr <MediaObjectImpl> object;
 
     object = std::dynamic_pointer_cast<MediaObjectImpl> (
                factory->createObject (config, sessionId, params["constructorParams"]) );
+    ticket.finish ();
 
     response[VALUE] = object->getId();
     response[SESSION_ID] = sessionId;
@@ -677,122 +806,263 @@ ServerMethods::create (const Json::Value &params,
 
     data[TYPE] = ex.getType();
 
+    if (ex.getCode () == NOT_ENOUGH_RESOURCES) {
+      /* Milliseconds after which the creation may be accepted */
+      data["retryAfter"] = (Json::Int64) admissionControl->getRetryAfter ().count ();
+    }
+
     throw JsonRpc::CallException (ex.getCode (), ex.getMessage (), data);
   }
 }
 
+/*
+ * Operations run as soon as the ones they depend on succeed, concurrently
+ * on the executor. The result is the same as running them in order: the
+ * responses are those up to the first failed operation, and objects created
+ * meanwhile by later operations are released. If the first failed operation
+ * could not be run, its error is the error of the whole transaction.
+ */
 void
-insertResult (Json::Value &value, Json::Value &responses, const int index)
+ServerMethods::runTransaction (const Transaction &transaction,
+                               const std::string &sessionId, const Json::Value &parameterValues,
+                               Json::Value &response)
 {
-  try {
-    Json::Value result;
+  std::string uniqueId = generateUUID();
+  size_t size = transaction.size ();
+  std::vector<Json::Value> responses (size);
+  std::vector<size_t> pending (size);
+  std::vector<bool> executed (size);
+  std::vector<std::exception_ptr> errors (size);
+  size_t failed = size;
+  std::mutex mutex;
+  TaskGroup tasks (executor);
+  std::function<void (size_t)> execute;
+
+  transaction.checkParameters (parameterValues);
+
+  execute = [&] (size_t i) {
+    std::vector<size_t> ready;
+    bool ret;
 
-    JsonRpc::getValue (responses[index], JSON_RPC_RESULT, result);
-    value = result[VALUE];
-  } catch (JsonRpc::CallException e) {
-    Json::Value data;
+    /* Not propagated from here, so that the objects created by other
+     * operations are still released */
+    try {
+      Json::Value operation = transaction.getOperation (i, sessionId, uniqueId,
+                              responses, parameterValues);
 
-    KurentoException ke (MALFORMED_TRANSACTION,
-                         "Result not found on request " +
-                         std::to_string (index) );
+      ret = handler.process (operation, responses[i]);
+    } catch (...) {
+      errors[i] = std::current_exception ();
+      ret = false;
+    }
 
-    data[TYPE] = ke.getType();
+    responses[i][JSON_RPC_ID] = (Json::UInt) i;
 
-    GST_ERROR ("Error while inserting new ref value: %s",
-               e.getMessage ().c_str () );
-    throw JsonRpc::CallException (ke.getCode (), ke.getMessage (), data);
-  }
-}
+    std::unique_lock<std::mutex> lock (mutex);
 
-void
-injectRefs (Json::Value &params, Json::Value &responses)
-{
-  if (params.isObject () || params.isArray () ) {
-    for (auto &param : params) {
-      injectRefs(param, responses);
+    executed[i] = true;
+
+    if (!ret) {
+      failed = std::min (failed, i);
     }
-  } else if (params.isConvertibleTo (Json::ValueType::stringValue) ) {
-    std::string param = JsonFixes::getString (params);
 
-    if (param.size() > NEW_REF.size()
-        && param.substr (0, NEW_REF.size() ) == NEW_REF) {
-      std::string ref = param.substr (NEW_REF.size() );
+    /* Operations after a failure would not have been run */
+    for (size_t dependent : transaction.getDependents (i) ) {
+      if (--pending[dependent] == 0 && dependent < failed) {
+        ready.push_back (dependent);
+      }
+    }
 
-      try {
-        int index = stoi (ref);
+    lock.unlock ();
 
-        insertResult (params, responses, index);
-      } catch (std::invalid_argument &e) {
-        Json::Value data;
+    for (size_t dependent : ready) {
+      tasks.run (std::bind (execute, dependent) );
+    }
+  };
+
+  for (size_t i = 0; i < size; i++) {
+    pending[i] = transaction.getDependencies (i);
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    if (pending[i] == 0) {
+      tasks.run (std::bind (execute, i) );
+    }
+  }
 
-        KurentoException ke (MALFORMED_TRANSACTION,
-                             "Invalid index of newref '" + ref + "'");
+  tasks.wait ();
 
-        data[TYPE] = ke.getType();
+  Json::Value results (Json::arrayValue);
 
-        throw JsonRpc::CallException (ke.getCode (), ke.getMessage (), data);
+  for (size_t i = 0; i < size; i++) {
+    if (i <= failed) {
+      results.append (responses[i]);
+    } else if (executed[i]) {
+      /* Only creates can run concurrently with a failed operation */
+      std::string objectId;
+
+      if (tryGetValue (getMember (responses[i], JSON_RPC_RESULT), VALUE,
+                       objectId) ) {
+        GST_DEBUG ("Releasing %s, created after a failed operation",
+                   objectId.c_str () );
+
+        try {
+          MediaSet::getMediaSet()->release (objectId);
+        } catch (KurentoException &ex) {
+          GST_WARNING ("Cannot release %s: %s", objectId.c_str (),
+                       ex.getMessage ().c_str () );
+        }
       }
     }
   }
+
+  if (failed < size && errors[failed]) {
+    std::rethrow_exception (errors[failed]);
+  }
+
+  response[VALUE] = results;
+  response[SESSION_ID] = sessionId;
 }
 
+static void
+throwPreparedTransactionError (const std::string &name,
+                               const std::string &reason)
+{
+  Json::Value data;
+  KurentoException ke (MALFORMED_TRANSACTION,
+                       "Prepared transaction '" + name + "' " + reason);
+
+  data[TYPE] = ke.getType();
+
+  throw JsonRpc::CallException (ke.getCode (), ke.getMessage (), data);
+}
+
+std::shared_ptr<const Transaction>
+ServerMethods::getPreparedTransaction (const std::string &name)
+{
+  std::unique_lock<std::mutex> lock (preparedTransactionsMutex);
+  auto it = preparedTransactions.find (name);
+
+  if (it == preparedTransactions.end () ) {
+    throwPreparedTransactionError (name, "not found");
+  }
+
+  return it->second.transaction;
+}
+
+/*
+ * Runs the given operations, or a prepared transaction instantiated with
+ * the given parameters
+ */
 void
 ServerMethods::transaction (const Json::Value &params, Json::Value &response)
 {
   std::string sessionId;
+  std::string name;
+
+  requireParams (params);
+
+  getOrCreateSessionId (sessionId, params);
+
+  if (tryGetValue (params, TEMPLATE, name) ) {
+    runTransaction (*getPreparedTransaction (name), sessionId,
+                    getMember (params, PARAMETERS), response);
+    return;
+  }
+
   Json::Value operations;
-  std::string uniqueId = generateUUID();
+
+  JsonRpc::getArray (params, "operations", operations);
+
+  runTransaction (Transaction (operations), sessionId, Json::Value::null,
+                  response);
+}
+
+/*
+ * Validates and stores a transaction to be instantiated later by name,
+ * replacing the previous one of the same session with that name. Names
+ * prepared by other sessions are refused. Returns its parameters.
+ */
+void
+ServerMethods::prepareTransaction (const Json::Value &params,
+                                   Json::Value &response)
+{
+  std::string name;
+  Json::Value operations;
+  std::string sessionId;
 
   requireParams (params);
 
   getOrCreateSessionId (sessionId, params);
 
+  JsonRpc::getValue (params, NAME, name);
   JsonRpc::getArray (params, "operations", operations);
-  Json::Value responses;
 
-  for (uint i = 0; i < operations.size(); i++) {
-    bool ret;
+  std::shared_ptr<const Transaction> transaction =
+    std::make_shared<const Transaction> (operations, true);
 
-    Json::Value &reqParams = operations[i][JSON_RPC_PARAMS];
+  {
+    std::unique_lock<std::mutex> lock (preparedTransactionsMutex);
+    auto it = preparedTransactions.find (name);
 
-    reqParams[SESSION_ID] = sessionId;
+    if (it != preparedTransactions.end () && it->second.owner != sessionId) {
+      throwPreparedTransactionError (name, "belongs to another session");
+    }
 
-    if (!operations[i][JSON_RPC_ID].isConvertibleTo (Json::ValueType::uintValue)
-        || operations[i][JSON_RPC_ID].asUInt() != i) {
+    if (preparedTransactions.size () >= PREPARED_TRANSACTIONS_MAX
+        && it == preparedTransactions.end () ) {
       Json::Value data;
-
-      KurentoException ke (MALFORMED_TRANSACTION,
-                           "Id of request '" + std::to_string (i) +
-                           "' should be '" + std::to_string (i) + "'");
+      KurentoException ke (NOT_ENOUGH_RESOURCES,
+                           "Too many prepared transactions");
 
       data[TYPE] = ke.getType();
 
       throw JsonRpc::CallException (ke.getCode (), ke.getMessage (), data);
     }
 
-    try {
-      operations[i][JSON_RPC_ID] = uniqueId + "_" + std::to_string (
-                                     operations[i][JSON_RPC_ID].asUInt() );
-    } catch (...) {
-      GST_ERROR ("Error setting id");
-    }
+    preparedTransactions[name] = {transaction, sessionId};
+  }
 
-    injectRefs (reqParams, responses);
+  GST_DEBUG ("Prepared transaction '%s' with %zu operations", name.c_str (),
+             transaction->size () );
 
-    ret = handler.process (operations[i], responses[i]);
+  Json::Value parameters (Json::arrayValue);
 
-    responses[i][JSON_RPC_ID] = i;
+  for (const std::string &parameter : transaction->getParameters () ) {
+    parameters.append (parameter);
+  }
 
-    if (!ret) {
-      break;
+  response[VALUE] = parameters;
+  response[SESSION_ID] = sessionId;
+}
+
+void
+ServerMethods::releaseTransaction (const Json::Value &params,
+                                   Json::Value &response)
+{
+  std::string name;
+  std::string sessionId;
+
+  requireParams (params);
+
+  JsonRpc::getValue (params, NAME, name);
+  tryGetValue (params, SESSION_ID, sessionId);
+
+  {
+    std::unique_lock<std::mutex> lock (preparedTransactionsMutex);
+    auto it = preparedTransactions.find (name);
+
+    if (it == preparedTransactions.end () ) {
+      throwPreparedTransactionError (name, "not found");
+    }
+
+    if (it->second.owner != sessionId) {
+      throwPreparedTransactionError (name, "belongs to another session");
     }
-  }
 
-  if (responses.isNull () ) {
-    responses.resize (0);
+    preparedTransactions.erase (it);
   }
 
-  response[VALUE] = responses;
   response[SESSION_ID] = sessionId;
 }
 
@@ -801,10 +1071,8 @@ ServerMethods::ping (const Json::Value &params, Json::Value &response)
 {
   std::string sessionId;
 
-  try {
-    JsonRpc::getValue (params, SESSION_ID, sessionId);
+  if (tryGetValue (params, SESSION_ID, sessionId) ) {
     response [SESSION_ID] = sessionId;
-  } catch (JsonRpc::CallException e) {
   }
 
   if (sessionId.empty()) {
@@ -826,11 +1094,8 @@ ServerMethods::closeSession (const Json::Value &params,
 
   requireParams (params);
 
-  try {
-    JsonRpc::getValue (params, "release", release);
-  } catch (JsonRpc::CallException e) {
-    /* release param is optional*/
-  }
+  /* release param is optional*/
+  tryGetValue (params, "release", release);
 
   JsonRpc::getValue (params, SESSION_ID, sessionId);
 
@@ -841,6 +1106,96 @@ ServerMethods::closeSession (const Json::Value &params,
   }
 }
 
+/* -1 means unlimited */
+static Json::Value
+limitToJson (rlim_t limit)
+{
+  if (limit == RLIM_INFINITY) {
+    return Json::Value (-1);
+  }
+
+  return Json::Value ( (Json::UInt64) limit);
+}
+
+void
+ServerMethods::stats (const Json::Value &params, Json::Value &response)
+{
+  Json::Value value;
+  Json::Value cacheStats;
+
+  cacheStats["enabled"] = (cache != nullptr);
+
+  if (cache) {
+    RequestCache::Stats stats = cache->getStats ();
+
+    cacheStats["entries"] = (Json::UInt64) stats.entries;
+    cacheStats["sessions"] = (Json::UInt64) stats.sessions;
+    cacheStats["bytes"] = (Json::UInt64) stats.bytes;
+    cacheStats["maxBytes"] = (Json::UInt64) stats.maxBytes;
+    cacheStats["maxEntriesPerSession"] = (Json::UInt64) stats.maxEntriesPerSession;
+    cacheStats["hits"] = (Json::UInt64) stats.hits;
+    cacheStats["misses"] = (Json::UInt64) stats.misses;
+    cacheStats["expired"] = (Json::UInt64) stats.expired;
+    cacheStats["evicted"] = (Json::UInt64) stats.evicted;
+    cacheStats["evictedBySessionQuota"] = (Json::UInt64)
+                                          stats.evictedBySessionQuota;
+  }
+
+  value["requestCache"] = cacheStats;
+
+  ResourceUsage usage = getResourceUsage ();
+
+  value["resources"]["threads"] = (Json::Int64) usage.threads;
+  value["resources"]["openFiles"] = (Json::Int64) usage.openFiles;
+  value["resources"]["memory"] = (Json::Int64) usage.memory;
+  value["resources"]["cpu"] = getCpuLoad ();
+  value["resources"]["load"] = getLoadScore ();
+  value["resources"]["limits"]["threads"] = limitToJson (getMaxThreads () );
+  value["resources"]["limits"]["openFiles"] = limitToJson (getMaxOpenFiles () );
+  value["resources"]["limits"]["memory"] = limitToJson (getMaxMemory () );
+  value["resources"]["limits"]["cpus"] = getCpuLimit ();
+
+  admissionControl->getStats (value["admission"]);
+
+  StartupProfile::getInstance ().getStats (value["startup"]);
+
+  if (statsHandler) {
+    statsHandler (params, value);
+  }
+
+  response[VALUE] = value;
+}
+
+/* Kept small, as it is sent periodically: usage is read from the last
+ * sample and objects are counted without describing them */
+void
+ServerMethods::getLoadReport (Json::Value &report)
+{
+  std::shared_ptr<MediaSet> mediaSet = MediaSet::getMediaSet ();
+  std::list<std::shared_ptr<MediaObjectImpl>> pipelines =
+        mediaSet->getPipelines ();
+  ResourceUsage usage = getResourceUsage ();
+  Json::UInt64 elements = 0;
+
+  for (auto &pipeline : pipelines) {
+    elements += pipeline->getChildren ().size ();
+  }
+
+  report["sessions"] = (Json::UInt64) mediaSet->getSessions ().size ();
+  report["pipelines"] = (Json::UInt64) pipelines.size ();
+  report["elements"] = elements;
+  report["threads"]["used"] = (Json::Int64) usage.threads;
+  report["threads"]["limit"] = limitToJson (getMaxThreads () );
+  report["openFiles"]["used"] = (Json::Int64) usage.openFiles;
+  report["openFiles"]["limit"] = limitToJson (getMaxOpenFiles () );
+  report["memory"]["used"] = (Json::Int64) usage.memory;
+  report["memory"]["limit"] = limitToJson (getMaxMemory () );
+  report["cpu"]["load"] = getCpuLoad ();
+  report["cpu"]["cpus"] = getCpuLimit ();
+  report["cpu"]["overloaded"] = admissionControl->isCpuOverloaded ();
+  report["load"] = getLoadScore ();
+}
+
 ServerMethods::StaticConstructor ServerMethods::staticConstructor;
 
 ServerMethods::StaticConstructor::StaticConstructor()
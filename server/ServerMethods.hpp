@@ -25,10 +25,16 @@
 #include <Processor.hpp>
 #include "RequestCache.hpp"
 
+#include <map>
+#include <mutex>
+
 namespace kurento
 {
 
 class MediaObject;
+class RequestView;
+class Transaction;
+class AdmissionControl;
 
 class ServerMethods : public Processor
 {
@@ -37,8 +43,13 @@ public:
   ServerMethods (const boost::property_tree::ptree &config);
   virtual ~ServerMethods();
 
+  using Processor::process;
+
   virtual std::string process (const std::string &request, std::string &response,
                                std::string &sessionId);
+  /* Requests and responses use the encoding of the connection */
+  virtual std::string process (const std::string &request, std::string &response,
+                               const std::shared_ptr<ConnectionState> &connection);
 
   virtual void keepAliveSession (const std::string &sessionId);
 
@@ -60,10 +71,34 @@ protected:
     eventSubscriptionHandler = e;
   }
 
+  virtual void setStatsHandler (std::function < void (const Json::Value &params,
+                                Json::Value &stats) > s)
+  {
+    statsHandler = s;
+  }
+
+  virtual void setExecutor (std::function < void (std::function<void ()>) > e)
+  {
+    executor = e;
+  }
+
+  virtual void getLoadReport (Json::Value &report);
+
 private:
 
-  bool preProcess (const Json::Value &request, Json::Value &response);
-  void postProcess (const Json::Value &request, Json::Value &response);
+  std::string dispatch (const std::string &requestStr, std::string &responseStr,
+                        std::string &sessionId, ConnectionState::Encoding encoding);
+  std::string dispatchRequest (RequestView &request, std::string &responseStr,
+                               const std::string &sessionId, ConnectionState::Encoding encoding);
+  std::string dispatchBatch (Json::Value &batch, std::string &responseStr,
+                             const std::string &sessionId, ConnectionState::Encoding encoding);
+
+  bool getCachedResponse (const RequestView &request,
+                          ConnectionState::Encoding encoding, std::string &responseStr,
+                          std::string &newSessionId);
+  void addCachedResponse (const RequestView &request,
+                          ConnectionState::Encoding encoding, const Json::Value &response,
+                          const std::string &responseStr, const std::string &newSessionId);
 
   void connect (const Json::Value &params, Json::Value &response);
   void create (const Json::Value &params, Json::Value &response);
@@ -76,8 +111,17 @@ private:
   void keepAlive (const Json::Value &params, Json::Value &response);
   void describe (const Json::Value &params, Json::Value &response);
   void transaction (const Json::Value &params, Json::Value &response);
+  void prepareTransaction (const Json::Value &params, Json::Value &response);
+  void releaseTransaction (const Json::Value &params, Json::Value &response);
+
+  void runTransaction (const Transaction &transaction,
+                       const std::string &sessionId, const Json::Value &parameterValues,
+                       Json::Value &response);
+  std::shared_ptr<const Transaction> getPreparedTransaction (
+    const std::string &name);
   void ping (const Json::Value &params, Json::Value &response);
   void closeSession (const Json::Value &params, Json::Value &response);
+  void stats (const Json::Value &params, Json::Value &response);
 
   const boost::property_tree::ptree &config;
   JsonRpc::Handler handler;
@@ -86,9 +130,22 @@ private:
 
   std::function<std::string (std::shared_ptr<MediaObjectImpl> obj, const std::string &sessionId, const std::string &eventType, const Json::Value &params) >
   eventSubscriptionHandler;
+  std::function<void (const Json::Value &params, Json::Value &stats) >
+  statsHandler;
+  std::function<void (std::function<void ()>) > executor;
 
   ModuleManager &moduleManager;
   std::shared_ptr<RequestCache> cache;
+  std::shared_ptr<AdmissionControl> admissionControl;
+
+  /* Transactions prepared by clients. All the sessions can run them, only
+   * the session that prepared one can replace or release it */
+  struct PreparedTransaction {
+    std::shared_ptr<const Transaction> transaction;
+    std::string owner;
+  };
+  std::map<std::string, PreparedTransaction> preparedTransactions;
+  std::mutex preparedTransactionsMutex;
   std::string instanceId;
 
   class StaticConstructor
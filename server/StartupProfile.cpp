@@ -0,0 +1,238 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "StartupProfile.hpp"
+#include "JsonUtils.hpp"
+#include "modules.hpp"
+
+#include <gst/gst.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define GST_CAT_DEFAULT kurento_startup_profile
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "KurentoStartupProfile"
+
+namespace kurento
+{
+
+template <typename Duration>
+static double
+toMs (Duration duration)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>
+         (duration).count () / 1000.0;
+}
+
+/* Sends a state to the service manager, as sd_notify does */
+static void
+notifyServiceManager (const std::string &state)
+{
+  const char *socketPath = getenv ("NOTIFY_SOCKET");
+  struct sockaddr_un addr;
+  size_t len;
+  int fd;
+
+  if (socketPath == nullptr || (socketPath[0] != '/' && socketPath[0] != '@') ) {
+    return;
+  }
+
+  len = strlen (socketPath);
+
+  if (len >= sizeof (addr.sun_path) ) {
+    GST_WARNING ("Invalid NOTIFY_SOCKET: %s", socketPath);
+    return;
+  }
+
+  memset (&addr, 0, sizeof (addr) );
+  addr.sun_family = AF_UNIX;
+  memcpy (addr.sun_path, socketPath, len);
+
+  /* Abstract socket namespace */
+  if (addr.sun_path[0] == '@') {
+    addr.sun_path[0] = '\0';
+  }
+
+  fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+  if (fd < 0) {
+    GST_WARNING ("Cannot notify service manager: %s", strerror (errno) );
+    return;
+  }
+
+  if (sendto (fd, state.data (), state.size (), MSG_NOSIGNAL,
+              (struct sockaddr *) &addr, offsetof (struct sockaddr_un, sun_path) + len) < 0) {
+    GST_WARNING ("Cannot notify service manager: %s", strerror (errno) );
+  }
+
+  close (fd);
+}
+
+StartupProfile &
+StartupProfile::getInstance ()
+{
+  static StartupProfile profile;
+
+  return profile;
+}
+
+StartupProfile::StartupProfile () :
+  start (std::chrono::steady_clock::now () ), last (start)
+{
+}
+
+void
+StartupProfile::finishPhase (const std::string &name)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+  auto now = std::chrono::steady_clock::now ();
+
+  phases.push_back ({name,
+                     std::chrono::duration_cast<std::chrono::microseconds> (now - last)
+                    });
+  last = now;
+
+  GST_DEBUG ("Startup phase %s finished in %.2f ms", name.c_str (),
+             toMs (phases.back ().duration) );
+}
+
+void
+StartupProfile::setReady (const std::string &readyFile)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+  std::stringstream summary;
+  std::string serialized;
+
+  ready = true;
+  this->readyFile = readyFile;
+
+  for (size_t i = 0; i < phases.size (); i++) {
+    summary << (i == 0 ? "" : ", ") << phases[i].name << ": "
+            << toMs (phases[i].duration) << " ms";
+  }
+
+  GST_INFO ("Startup finished in %.2f ms (%s)", toMs (last - start),
+            summary.str ().c_str () );
+
+  notifyServiceManager ("READY=1\nSTATUS=Accepting connections\nMAINPID=" +
+                        std::to_string (getpid () ) );
+
+  if (readyFile.empty () ) {
+    return;
+  }
+
+  writeJson (toJson (), serialized);
+
+  std::string tmpFile = readyFile + ".tmp";
+  std::ofstream stream (tmpFile, std::ios::trunc);
+
+  stream << serialized << std::endl;
+  stream.close ();
+
+  /* Renamed so that watchers never see a partial file */
+  if (!stream || rename (tmpFile.c_str (), readyFile.c_str () ) != 0) {
+    GST_WARNING ("Cannot write ready file %s", readyFile.c_str () );
+    unlink (tmpFile.c_str () );
+  }
+}
+
+void
+StartupProfile::setStopping ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  if (!ready) {
+    return;
+  }
+
+  ready = false;
+  notifyServiceManager ("STOPPING=1");
+
+  if (!readyFile.empty () ) {
+    unlink (readyFile.c_str () );
+  }
+}
+
+void
+StartupProfile::getStats (Json::Value &stats)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  stats = toJson ();
+}
+
+Json::Value
+StartupProfile::toJson ()
+{
+  const ModulesLoadReport &report = getModulesLoadReport ();
+  Json::Value value;
+  Json::Value phasesValue (Json::arrayValue);
+  Json::Value modulesValue;
+  Json::Value loadedValue (Json::arrayValue);
+
+  value["ready"] = ready;
+  value["totalMs"] = toMs (last - start);
+
+  for (const Phase &phase : phases) {
+    Json::Value phaseValue;
+
+    phaseValue["name"] = phase.name;
+    phaseValue["ms"] = toMs (phase.duration);
+    phasesValue.append (phaseValue);
+  }
+
+  value["phases"] = phasesValue;
+
+  modulesValue["discoveryMs"] = toMs (report.discovery);
+  modulesValue["prefetchMs"] = toMs (report.prefetch);
+  modulesValue["loadMs"] = toMs (report.load);
+  modulesValue["manifestUsed"] = report.manifestUsed;
+  modulesValue["skipped"] = (Json::UInt64) report.skipped;
+
+  for (const ModulesLoadReport::Module &module : report.modules) {
+    Json::Value moduleValue;
+
+    moduleValue["name"] = module.name;
+    moduleValue["path"] = module.path;
+    moduleValue["ms"] = toMs (module.duration);
+    loadedValue.append (moduleValue);
+  }
+
+  modulesValue["loaded"] = loadedValue;
+  value["modules"] = modulesValue;
+
+  return value;
+}
+
+} /* kurento */
+
+static void init_debug() __attribute__((constructor));
+
+static void init_debug() {
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+                           GST_DEFAULT_NAME);
+}
@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __STARTUP_PROFILE_HPP__
+#define __STARTUP_PROFILE_HPP__
+
+#include <json/json.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kurento
+{
+
+/*
+ * Timeline of the server startup, made of consecutive phases: each one lasts
+ * from the end of the previous phase until it is finished. The timeline
+ * starts when the profile is first used.
+ *
+ * Once the transport accepts connections the server is set as ready, which
+ * is announced to the service manager (sd_notify protocol, if NOTIFY_SOCKET
+ * is set) and by writing the timeline to the ready file, if any.
+ */
+class StartupProfile
+{
+public:
+  static StartupProfile &getInstance ();
+
+  void finishPhase (const std::string &name);
+
+  void setReady (const std::string &readyFile);
+  void setStopping ();
+
+  void getStats (Json::Value &stats);
+
+private:
+  struct Phase {
+    std::string name;
+    std::chrono::microseconds duration;
+  };
+
+  StartupProfile ();
+
+  Json::Value toJson ();
+
+  std::mutex mutex;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point last;
+  std::vector<Phase> phases;
+  bool ready = false;
+  std::string readyFile;
+};
+
+} /* kurento */
+
+#endif /* __STARTUP_PROFILE_HPP__ */
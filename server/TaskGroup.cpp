@@ -0,0 +1,122 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "TaskGroup.hpp"
+
+namespace kurento
+{
+
+TaskGroup::TaskGroup (const Executor &executor) : executor (executor),
+  state (std::make_shared<State> () )
+{
+}
+
+TaskGroup::~TaskGroup ()
+{
+  /* Tasks may reference the stack of the thread that created the group */
+  try {
+    wait ();
+  } catch (...) {
+  }
+}
+
+void
+TaskGroup::run (std::function<void ()> task)
+{
+  std::shared_ptr<State> state = this->state;
+
+  {
+    std::unique_lock<std::mutex> lock (state->mutex);
+
+    state->tasks.push_back (std::move (task) );
+  }
+
+  state->cond.notify_all ();
+
+  if (executor) {
+    executor ([state] () {
+      runNext (state);
+    });
+  }
+}
+
+bool
+TaskGroup::runNext (const std::shared_ptr<State> &state)
+{
+  std::function<void ()> task;
+
+  {
+    std::unique_lock<std::mutex> lock (state->mutex);
+
+    if (state->tasks.empty () ) {
+      return false;
+    }
+
+    task = std::move (state->tasks.front () );
+    state->tasks.pop_front ();
+    state->running++;
+  }
+
+  try {
+    task ();
+  } catch (...) {
+    std::unique_lock<std::mutex> lock (state->mutex);
+
+    if (!state->error) {
+      state->error = std::current_exception ();
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock (state->mutex);
+
+    state->running--;
+  }
+
+  state->cond.notify_all ();
+
+  return true;
+}
+
+void
+TaskGroup::wait ()
+{
+  std::exception_ptr error;
+
+  for (;;) {
+    if (runNext (state) ) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock (state->mutex);
+
+    if (state->tasks.empty () && state->running == 0) {
+      error = state->error;
+      state->error = nullptr;
+      break;
+    }
+
+    state->cond.wait (lock, [this] () {
+      return !state->tasks.empty () || state->running == 0;
+    });
+  }
+
+  if (error) {
+    std::rethrow_exception (error);
+  }
+}
+
+} /* kurento */
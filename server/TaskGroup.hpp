@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __TASK_GROUP_HPP__
+#define __TASK_GROUP_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace kurento
+{
+
+/*
+ * Runs a group of tasks concurrently on an executor, such as the RPC worker
+ * pool, and waits for all of them to complete.
+ *
+ * The waiting thread also takes queued tasks, so the group completes even
+ * when every worker is busy, and waiting from a worker cannot deadlock.
+ * Without an executor, tasks are run sequentially by wait (). Tasks can add
+ * new tasks to the group while it runs.
+ */
+class TaskGroup
+{
+public:
+  typedef std::function<void (std::function<void ()>)> Executor;
+
+  TaskGroup (const Executor &executor);
+  ~TaskGroup ();
+
+  void run (std::function<void ()> task);
+
+  /* Returns when all tasks are done, rethrowing the first exception raised
+   * by any of them */
+  void wait ();
+
+private:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::function<void ()>> tasks;
+    int running = 0;
+    std::exception_ptr error;
+  };
+
+  /* Runs the next queued task, if any; returns false if there was none */
+  static bool runNext (const std::shared_ptr<State> &state);
+
+  Executor executor;
+  /* Shared with the work posted to the executor, which can run after the
+   * group is destroyed and then finds no tasks */
+  std::shared_ptr<State> state;
+};
+
+} /* kurento */
+
+#endif /* __TASK_GROUP_HPP__ */
@@ -0,0 +1,100 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "TimerWheel.hpp"
+#include "CacheEntry.hpp"
+
+#include <utility>
+
+namespace kurento
+{
+
+TimerWheel::TimerWheel (uint64_t tick) : current (tick)
+{
+}
+
+void
+TimerWheel::schedule (std::shared_ptr<CacheEntry> entry)
+{
+  uint64_t expiration = entry->getExpiration ();
+
+  if (expiration <= current) {
+    /* Already due, it will be returned on the next advance */
+    near[ (current + 1) & WHEEL_MASK].push_back (entry);
+  } else if (expiration - current < WHEEL_SLOTS) {
+    near[expiration & WHEEL_MASK].push_back (entry);
+  } else {
+    /* Entries beyond the range of the second level are parked in its last
+     * slot and rescheduled when that slot is cascaded */
+    uint64_t limit = current + WHEEL_SLOTS * WHEEL_SLOTS - 1;
+
+    if (expiration > limit) {
+      expiration = limit;
+    }
+
+    far[ (expiration >> WHEEL_BITS) & WHEEL_MASK].push_back (entry);
+  }
+}
+
+void
+TimerWheel::cascade ()
+{
+  Slot entries;
+
+  entries.swap (far[ (current >> WHEEL_BITS) & WHEEL_MASK]);
+
+  for (auto &ref : entries) {
+    std::shared_ptr<CacheEntry> entry = ref.lock ();
+
+    if (entry) {
+      schedule (std::move (entry) );
+    }
+  }
+}
+
+void
+TimerWheel::advance (uint64_t tick,
+                     std::vector<std::shared_ptr<CacheEntry>> &expired)
+{
+  while (current < tick) {
+    Slot entries;
+
+    current++;
+
+    if ( (current & WHEEL_MASK) == 0) {
+      cascade ();
+    }
+
+    entries.swap (near[current & WHEEL_MASK]);
+
+    for (auto &ref : entries) {
+      std::shared_ptr<CacheEntry> entry = ref.lock ();
+
+      if (!entry) {
+        continue;
+      }
+
+      if (entry->getExpiration () <= current) {
+        expired.push_back (std::move (entry) );
+      } else {
+        schedule (std::move (entry) );
+      }
+    }
+  }
+}
+
+} // kurento
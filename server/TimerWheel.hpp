@@ -0,0 +1,72 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace kurento
+{
+
+class CacheEntry;
+
+/*
+ * Two-level hierarchical timing wheel for CacheEntry expiration.
+ *
+ * Time is measured in ticks. The first level has one slot per tick; the
+ * second level has one slot per full turn of the first level, and its slots
+ * are cascaded down into the first level as time advances. Inserting an
+ * entry is O(1) and all the entries expiring in the same tick are returned
+ * together by advance(). The wheel only keeps weak references, so entries
+ * removed from the cache before expiring are released right away.
+ *
+ * This class is not thread-safe; callers must provide locking.
+ */
+class TimerWheel
+{
+public:
+  TimerWheel (uint64_t tick);
+
+  void schedule (std::shared_ptr<CacheEntry> entry);
+  void advance (uint64_t tick, std::vector<std::shared_ptr<CacheEntry>> &expired);
+
+  uint64_t getTick () const
+  {
+    return current;
+  }
+
+private:
+  static const unsigned int WHEEL_BITS = 6;
+  static const uint64_t WHEEL_SLOTS = 1 << WHEEL_BITS;
+  static const uint64_t WHEEL_MASK = WHEEL_SLOTS - 1;
+
+  typedef std::vector<std::weak_ptr<CacheEntry>> Slot;
+
+  void cascade ();
+
+  uint64_t current;
+  std::array<Slot, WHEEL_SLOTS> near;
+  std::array<Slot, WHEEL_SLOTS> far;
+};
+
+} // kurento
+
+#endif /* __TIMER_WHEEL_H__ */
@@ -0,0 +1,212 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "Transaction.hpp"
+#include "JsonUtils.hpp"
+
+#include <KurentoException.hpp>
+#include <jsonrpc/JsonRpcException.hpp>
+#include <jsonrpc/JsonRpcConstants.hpp>
+
+#include <set>
+
+#define SESSION_ID "sessionId"
+#define VALUE "value"
+#define TYPE "type"
+
+static const std::string NEW_REF = "newref:";
+static const std::string PARAM_REF = "param:";
+
+namespace kurento
+{
+
+static void
+throwMalformedTransaction (const std::string &message)
+{
+  Json::Value data;
+  KurentoException ke (MALFORMED_TRANSACTION, message);
+
+  data[TYPE] = ke.getType();
+
+  throw JsonRpc::CallException (ke.getCode (), ke.getMessage (), data);
+}
+
+static bool
+hasPrefix (const std::string &value, const std::string &prefix)
+{
+  return value.size () > prefix.size ()
+         && value.compare (0, prefix.size (), prefix) == 0;
+}
+
+Transaction::Transaction (const Json::Value &operations, bool prepared) :
+  operations (operations.begin (), operations.end () ),
+  placeholders (operations.size () ), dependents (operations.size () ),
+  dependencies (operations.size () ), prepared (prepared)
+{
+  std::set<std::string> parameterSet;
+  std::vector<size_t> sinceBarrier;
+  bool hasBarrier = false;
+  size_t barrier = 0;
+
+  for (size_t i = 0; i < size (); i++) {
+    const Json::Value &operation = this->operations[i];
+    std::set<size_t> required;
+    std::vector<Json::Value> path;
+    std::string method;
+
+    if (!operation.isObject ()
+        || !operation[JSON_RPC_ID].isConvertibleTo (Json::ValueType::uintValue)
+        || operation[JSON_RPC_ID].asUInt() != i) {
+      throwMalformedTransaction ("Id of request '" + std::to_string (i) +
+                                 "' should be '" + std::to_string (i) + "'");
+    }
+
+    collectPlaceholders (getMember (operation, JSON_RPC_PARAMS), i, path);
+
+    for (const Placeholder &placeholder : placeholders[i]) {
+      if (placeholder.ref < 0) {
+        parameterSet.insert (placeholder.parameter);
+      } else if ( (size_t) placeholder.ref >= i) {
+        throwMalformedTransaction ("Result not found on request " +
+                                   std::to_string (placeholder.ref) );
+      } else {
+        required.insert (placeholder.ref);
+      }
+    }
+
+    if (hasBarrier) {
+      required.insert (barrier);
+    }
+
+    tryGetValue (operation, JSON_RPC_METHOD, method);
+
+    if (method == "create") {
+      sinceBarrier.push_back (i);
+    } else {
+      required.insert (sinceBarrier.begin (), sinceBarrier.end () );
+      sinceBarrier.clear ();
+      hasBarrier = true;
+      barrier = i;
+    }
+
+    for (size_t dependency : required) {
+      dependents[dependency].push_back (i);
+    }
+
+    dependencies[i] = required.size ();
+  }
+
+  parameters.assign (parameterSet.begin (), parameterSet.end () );
+}
+
+void
+Transaction::collectPlaceholders (const Json::Value &value, size_t index,
+                                  std::vector<Json::Value> &path)
+{
+  if (value.isObject () || value.isArray () ) {
+    for (auto it = value.begin (); it != value.end (); it++) {
+      if (value.isArray () ) {
+        path.push_back (it.index () );
+      } else {
+        path.push_back (it.name () );
+      }
+
+      collectPlaceholders (*it, index, path);
+      path.pop_back ();
+    }
+
+    return;
+  }
+
+  if (!value.isString () ) {
+    return;
+  }
+
+  std::string str = value.asString ();
+  Placeholder placeholder;
+
+  if (hasPrefix (str, NEW_REF) ) {
+    std::string ref = str.substr (NEW_REF.size () );
+
+    try {
+      placeholder.ref = std::stoi (ref);
+    } catch (std::logic_error &e) {
+      throwMalformedTransaction ("Invalid index of newref '" + ref + "'");
+    }
+
+    if (placeholder.ref < 0) {
+      throwMalformedTransaction ("Invalid index of newref '" + ref + "'");
+    }
+  } else if (prepared && hasPrefix (str, PARAM_REF) ) {
+    placeholder.ref = -1;
+    placeholder.parameter = str.substr (PARAM_REF.size () );
+  } else {
+    return;
+  }
+
+  placeholder.path = path;
+  placeholders[index].push_back (placeholder);
+}
+
+void
+Transaction::checkParameters (const Json::Value &parameterValues) const
+{
+  for (const std::string &parameter : parameters) {
+    if (!parameterValues.isObject () || !parameterValues.isMember (parameter) ) {
+      throwMalformedTransaction ("Missing parameter '" + parameter + "'");
+    }
+  }
+}
+
+Json::Value
+Transaction::getOperation (size_t index, const std::string &sessionId,
+                           const std::string &uniqueId, const std::vector<Json::Value> &responses,
+                           const Json::Value &parameterValues) const
+{
+  Json::Value operation = operations[index];
+  Json::Value &params = operation[JSON_RPC_PARAMS];
+
+  for (const Placeholder &placeholder : placeholders[index]) {
+    Json::Value *target = &params;
+
+    for (const Json::Value &key : placeholder.path) {
+      target = key.isString () ? & (*target) [key.asString ()] :
+               & (*target) [key.asUInt ()];
+    }
+
+    if (placeholder.ref < 0) {
+      *target = getMember (parameterValues, placeholder.parameter);
+      continue;
+    }
+
+    const Json::Value &result = getMember (responses[placeholder.ref],
+                                           JSON_RPC_RESULT);
+
+    if (result.isNull () ) {
+      throwMalformedTransaction ("Result not found on request " +
+                                 std::to_string (placeholder.ref) );
+    }
+
+    *target = getMember (result, VALUE);
+  }
+
+  params[SESSION_ID] = sessionId;
+  operation[JSON_RPC_ID] = uniqueId + "_" + std::to_string (index);
+
+  return operation;
+}
+
+} /* kurento */
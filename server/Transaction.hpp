@@ -0,0 +1,103 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __TRANSACTION_HPP__
+#define __TRANSACTION_HPP__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+namespace kurento
+{
+
+/*
+ * Operations of a transaction, validated and indexed once so that they can
+ * be instantiated any number of times, as prepared transactions are.
+ *
+ * Strings "newref:N" in the params of an operation are replaced by the
+ * value returned by operation N. In prepared transactions, strings
+ * "param:NAME" are replaced by the parameter NAME given on instantiation,
+ * other transactions pass them through. Their locations are recorded when
+ * parsing, so instantiating an operation does not walk its params.
+ *
+ * Operations form a dependency graph: an operation depends on those it
+ * references. Operations other than create keep their relative order and
+ * act as barriers: they wait for all the previous operations, and the
+ * following ones wait for them. So only creates run concurrently.
+ *
+ * Errors are thrown as JsonRpc::CallException with MALFORMED_TRANSACTION.
+ */
+class Transaction
+{
+public:
+  Transaction (const Json::Value &operations, bool prepared = false);
+
+  size_t size () const
+  {
+    return operations.size ();
+  }
+
+  /* Names of the parameters used by the operations */
+  const std::vector<std::string> &getParameters () const
+  {
+    return parameters;
+  }
+
+  size_t getDependencies (size_t index) const
+  {
+    return dependencies[index];
+  }
+
+  const std::vector<size_t> &getDependents (size_t index) const
+  {
+    return dependents[index];
+  }
+
+  /* Checks that all the parameters have a value */
+  void checkParameters (const Json::Value &parameterValues) const;
+
+  /* Returns the request of an operation, ready to be processed, given the
+   * responses of the operations it depends on */
+  Json::Value getOperation (size_t index, const std::string &sessionId,
+                            const std::string &uniqueId, const std::vector<Json::Value> &responses,
+                            const Json::Value &parameterValues) const;
+
+private:
+  struct Placeholder {
+    /* Keys from the params of the operation */
+    std::vector<Json::Value> path;
+    /* Index of the referenced operation, or -1 for a parameter */
+    int ref;
+    std::string parameter;
+  };
+
+  void collectPlaceholders (const Json::Value &value, size_t index,
+                            std::vector<Json::Value> &path);
+
+  std::vector<Json::Value> operations;
+  std::vector<std::vector<Placeholder>> placeholders;
+  std::vector<std::vector<size_t>> dependents;
+  std::vector<size_t> dependencies;
+  std::vector<std::string> parameters;
+  bool prepared;
+};
+
+} /* kurento */
+
+#endif /* __TRANSACTION_HPP__ */
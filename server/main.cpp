@@ -40,6 +40,7 @@
 #include "logging.hpp"
 #include "modules.hpp"
 #include "loadConfig.hpp"
+#include "StartupProfile.hpp"
 
 #include "MediaSet.hpp"
 
@@ -120,12 +121,16 @@ main (int argc, char **argv)
   std::shared_ptr<Transport> transport;
   boost::property_tree::ptree config;
   std::string confFile;
-  std::string modulesPath, logsPath, modulesConfigPath;
+  std::string modulesPath, modulesManifest, logsPath, modulesConfigPath;
+  std::string readyFile;
   int fileSize, fileNumber;
 
   Debug::DeathHandler dh;
   dh.set_thread_safe (true);
 
+  /* Startup timeline begins here */
+  StartupProfile::getInstance ();
+
   kms_init_dependencies (&argc, &argv);
 
   if (gst_debug_get_color_mode() == GST_DEBUG_COLOR_MODE_OFF) {
@@ -143,6 +148,11 @@ main (int argc, char **argv)
     ("list,l", "Lists all available factories")
     ("modules-path,p", boost::program_options::value<std::string>
      (&modulesPath), "Colon-separated path(s) where Kurento modules can be found")
+    ("modules-manifest", boost::program_options::value<std::string>
+     (&modulesManifest),
+     "File where found modules are cached to speed up startup")
+    ("ready-file", boost::program_options::value<std::string> (&readyFile),
+     "File created with the startup timeline once the server is ready")
     ("conf-file,f", boost::program_options::value<std::string>
      (&confFile)->default_value (DEFAULT_CONFIG_FILE),
      "Configuration file location")
@@ -209,7 +219,9 @@ main (int argc, char **argv)
       gst_debug_remove_log_function_by_data(nullptr);
     }
 
-    loadModules (modulesPath);
+    StartupProfile::getInstance ().finishPhase ("init");
+    loadModules (modulesPath, modulesManifest);
+    StartupProfile::getInstance ().finishPhase ("loadModules");
 
     if (vm.count ("list") ) {
       std::cout << "Available factories:" << std::endl;
@@ -251,16 +263,35 @@ main (int argc, char **argv)
     killServerOnLowResources (*killResourceLimit);
   }
 
+  long samplingPeriod = config.get<long> (
+                          "mediaServer.resources.samplingPeriod",
+                          DEFAULT_RESOURCE_SAMPLING_PERIOD.count () );
+
+  if (samplingPeriod > 0) {
+    startResourceSampler (std::chrono::milliseconds (samplingPeriod) );
+  }
+
+  StartupProfile::getInstance ().finishPhase ("loadConfig");
+
   transport = createTransportFromConfig (config);
 
+  StartupProfile::getInstance ().finishPhase ("createTransport");
+
   /* Start transport */
   transport->start ();
 
+  StartupProfile::getInstance ().finishPhase ("startTransport");
+
   GST_INFO ("Kurento Media Server started");
 
+  StartupProfile::getInstance ().setReady (readyFile);
+
   loop->run ();
 
+  StartupProfile::getInstance ().setStopping ();
+
   transport->stop();
+  stopResourceSampler ();
   MediaSet::deleteMediaSet();
 
   GST_INFO ("Kurento Media Server stopped");
@@ -15,21 +15,521 @@
  *
  */
 
+#include <config.h>
+
 #include "modules.hpp"
+#include "JsonUtils.hpp"
+
+#include <gst/gst.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <set>
+#include <sstream>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GST_CAT_DEFAULT kurento_modules
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "KurentoModules"
+
+#define MANIFEST_VERSION 1
 
 namespace kurento
 {
 
 static ModuleManager moduleManager;
+static ModulesLoadReport loadReport;
+
+namespace
+{
+
+struct Library {
+  std::string path;
+  int64_t mtime;
+  int64_t size;
+  /* Module registered by the library, only valid if known */
+  std::string module;
+  /* Whether the manifest describes this version of the file */
+  bool known;
+};
+
+struct Location {
+  std::string path;
+  /* Modification time of every directory walked, keyed by path */
+  std::map<std::string, int64_t> directories;
+  std::vector<Library> libraries;
+  bool cached;
+};
+
+} /* namespace */
+
+static bool
+statFile (const std::string &path, int64_t &mtime, int64_t &size)
+{
+  struct stat st;
+
+  if (stat (path.c_str (), &st) != 0) {
+    return false;
+  }
+
+  mtime = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  size = st.st_size;
+
+  return true;
+}
+
+static std::vector<std::string>
+split (const std::string &s, char delim)
+{
+  std::vector<std::string> elems;
+  std::stringstream ss (s);
+  std::string item;
+
+  while (std::getline (ss, item, delim) ) {
+    if (!item.empty () ) {
+      elems.push_back (item);
+    }
+  }
+
+  return elems;
+}
+
+/* Modification time of a directory, 0 if it does not exist */
+static int64_t
+getDirectoryMtime (const std::string &path)
+{
+  int64_t mtime, size;
+
+  if (!statFile (path, mtime, size) ) {
+    return 0;
+  }
+
+  return mtime;
+}
+
+static void
+walkDirectory (Location &location, const boost::filesystem::path &dir)
+{
+  boost::system::error_code ec;
+
+  location.directories[dir.string ()] = getDirectoryMtime (dir.string () );
+
+  for (boost::filesystem::directory_iterator itr (dir, ec), end;
+       !ec && itr != end; itr.increment (ec) ) {
+    const boost::filesystem::path &path = itr->path ();
+
+    if (boost::filesystem::is_directory (path, ec) ) {
+      walkDirectory (location, path);
+    } else if (boost::filesystem::is_regular_file (path, ec)
+               && path.extension () == ".so") {
+      location.libraries.push_back ({path.string (), 0, 0, "", false});
+    }
+  }
+}
+
+static std::vector<Library>
+readCachedLibraries (const Json::Value &cached)
+{
+  std::vector<Library> libraries;
+
+  for (const Json::Value &library : cached["libraries"]) {
+    const Json::Value &module = library["module"];
+
+    if (!library["path"].isString () ) {
+      continue;
+    }
+
+    libraries.push_back ({library["path"].asString (),
+                          library.get ("mtime", 0).asInt64 (),
+                          library.get ("size", 0).asInt64 (),
+                          module.isString () ? module.asString () : "",
+                          module.isString ()
+                         });
+  }
+
+  return libraries;
+}
+
+/* Directories of the manifest are unchanged if none has been modified,
+ * which means that no library has been added or removed */
+static bool
+areDirectoriesUnchanged (const Json::Value &cached)
+{
+  const Json::Value &directories = cached["directories"];
+
+  if (!directories.isObject () || directories.empty () ) {
+    return false;
+  }
+
+  for (auto it = directories.begin (); it != directories.end (); it++) {
+    if (!it->isInt64 ()
+        || getDirectoryMtime (it.name () ) != it->asInt64 () ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static Location
+discoverLocation (const std::string &path, const Json::Value &cached)
+{
+  Location location;
+  boost::filesystem::path dir (path);
+  std::vector<Library> cachedLibraries = readCachedLibraries (cached);
+
+  dir.normalize ();
+  location.path = path;
+  location.cached = areDirectoriesUnchanged (cached);
+
+  if (location.cached) {
+    const Json::Value &directories = cached["directories"];
+
+    for (auto it = directories.begin (); it != directories.end (); it++) {
+      location.directories[it.name ()] = it->asInt64 ();
+    }
+
+    location.libraries = cachedLibraries;
+  } else if (!boost::filesystem::is_directory (dir) ) {
+    GST_WARNING ("Unable to load modules from: %s, it is not a directory",
+                 path.c_str () );
+    /* Recorded as missing, so it is walked once it is created */
+    location.directories[dir.string ()] = 0;
+  } else {
+    std::map<std::string, Library> known;
+
+    for (const Library &library : cachedLibraries) {
+      known[library.path] = library;
+    }
+
+    walkDirectory (location, dir);
+    std::sort (location.libraries.begin (), location.libraries.end (),
+    [] (const Library & a, const Library & b) {
+      return a.path < b.path;
+    });
+
+    /* Libraries already in the manifest keep what is known about them */
+    for (Library &library : location.libraries) {
+      auto it = known.find (library.path);
+
+      if (it != known.end () ) {
+        library = it->second;
+      }
+    }
+  }
+
+  /* Files replaced in place do not change the directory */
+  for (Library &library : location.libraries) {
+    int64_t mtime, size;
+
+    if (!statFile (library.path, mtime, size) ) {
+      library.known = false;
+      continue;
+    }
+
+    if (mtime != library.mtime || size != library.size) {
+      library.mtime = mtime;
+      library.size = size;
+      library.known = false;
+      library.module.clear ();
+    }
+  }
+
+  return location;
+}
+
+static bool
+isSkipped (const Library &library)
+{
+  return library.known && library.module.empty ();
+}
+
+/* Asks the kernel to read ahead the libraries that are going to be loaded,
+ * so dlopen finds them in the page cache */
+static void
+prefetchLocation (const Location &location)
+{
+  for (const Library &library : location.libraries) {
+    if (isSkipped (library) ) {
+      continue;
+    }
+
+    int fd = open (library.path.c_str (), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+      continue;
+    }
+
+    posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+    close (fd);
+  }
+}
+
+static std::string
+getDefaultManifest ()
+{
+  return std::string (g_get_user_cache_dir () ) +
+         "/kurento/modules-manifest.json";
+}
+
+static Json::Value
+readManifest (const std::string &file)
+{
+  Json::Value manifest;
+  Json::CharReaderBuilder builder;
+  std::ifstream stream (file);
+  std::string errors;
+
+  if (!stream || !Json::parseFromStream (builder, stream, &manifest, &errors)
+      || !manifest.isObject ()
+      || manifest.get ("version", 0) != MANIFEST_VERSION) {
+    GST_DEBUG ("No valid modules manifest in %s", file.c_str () );
+    return Json::Value (Json::objectValue);
+  }
+
+  return manifest;
+}
+
+static void
+writeManifest (const std::string &file, const std::vector<Location> &locations)
+{
+  Json::Value manifest (Json::objectValue);
+  boost::system::error_code ec;
+  std::string tmpFile = file + ".tmp";
+  std::string serialized;
+
+  manifest["version"] = MANIFEST_VERSION;
+
+  for (const Location &location : locations) {
+    Json::Value &value = manifest["locations"][location.path];
+
+    value["directories"] = Json::Value (Json::objectValue);
+    value["libraries"] = Json::Value (Json::arrayValue);
+
+    for (auto &directory : location.directories) {
+      value["directories"][directory.first] = (Json::Int64) directory.second;
+    }
+
+    for (const Library &library : location.libraries) {
+      Json::Value entry;
+
+      entry["path"] = library.path;
+      entry["mtime"] = (Json::Int64) library.mtime;
+      entry["size"] = (Json::Int64) library.size;
+      /* Null for libraries never loaded, as duplicated file names, or that
+       * failed to load */
+      entry["module"] = library.known ? Json::Value (library.module) :
+                        Json::Value ();
+      value["libraries"].append (entry);
+    }
+  }
+
+  boost::filesystem::create_directories (
+    boost::filesystem::path (file).parent_path (), ec);
+
+  writeJson (manifest, serialized);
+
+  {
+    std::ofstream stream (tmpFile, std::ios::trunc);
+
+    stream << serialized;
+
+    if (!stream) {
+      GST_WARNING ("Cannot write modules manifest %s", file.c_str () );
+      return;
+    }
+  }
+
+  /* Replaced atomically, concurrent instances read a complete manifest */
+  boost::filesystem::rename (tmpFile, file, ec);
+
+  if (ec) {
+    GST_WARNING ("Cannot write modules manifest %s: %s", file.c_str (),
+                 ec.message ().c_str () );
+  }
+}
+
+/* Whether the library can be loaded, so that not registering a module means
+ * it is not one rather than a failure such as a missing dependency */
+static bool
+isLoadable (const std::string &path)
+{
+  void *handle = dlopen (path.c_str (), RTLD_NOW | RTLD_LOCAL);
+
+  if (handle == nullptr) {
+    return false;
+  }
+
+  dlclose (handle);
+
+  return true;
+}
+
+/* Returns the name of the module registered by the last loadModule call */
+static std::string
+getNewModule (const std::map<std::string, std::shared_ptr<ModuleData>> &before)
+{
+  for (auto &module : moduleManager.getModules () ) {
+    if (before.find (module.first) == before.end () ) {
+      return module.second->getName ();
+    }
+  }
+
+  return "";
+}
+
+template <typename Duration>
+static double
+toMs (Duration duration)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>
+         (duration).count () / 1000.0;
+}
 
 ModuleManager &getModuleManager ()
 {
   return moduleManager;
 }
 
-void loadModules (const std::string &path)
+const ModulesLoadReport &getModulesLoadReport ()
 {
-  moduleManager.loadModulesFromDirectories (path);
+  return loadReport;
+}
+
+void loadModules (const std::string &path, const std::string &manifest)
+{
+  std::string manifestFile = manifest.empty () ? getDefaultManifest () :
+                             manifest;
+  std::vector<std::string> paths = split (path, ':');
+  std::vector<std::future<Location>> discoveries;
+  std::vector<std::future<void>> prefetches;
+  std::vector<Location> locations;
+  std::set<std::string> fileNames;
+  Json::Value cached = readManifest (manifestFile);
+  auto start = std::chrono::steady_clock::now ();
+  bool changed = false;
+
+#ifdef KURENTO_MODULES_DIR
+  paths.push_back (KURENTO_MODULES_DIR);
+#endif
+
+  loadReport = ModulesLoadReport ();
+
+  /* Locations are independent, they are walked concurrently */
+  for (const std::string &location : paths) {
+    discoveries.push_back (std::async (std::launch::async, discoverLocation,
+                                       location, cached["locations"][location]) );
+  }
+
+  for (auto &discovery : discoveries) {
+    locations.push_back (discovery.get () );
+  }
+
+  auto discovered = std::chrono::steady_clock::now ();
+
+  for (const Location &location : locations) {
+    prefetches.push_back (std::async (std::launch::async, prefetchLocation,
+                                      std::cref (location) ) );
+  }
+
+  for (auto &prefetch : prefetches) {
+    prefetch.get ();
+  }
+
+  auto prefetched = std::chrono::steady_clock::now ();
+
+  /* ModuleManager is not thread safe and dlopen serializes on the loader
+   * lock, so libraries are loaded one by one */
+  for (Location &location : locations) {
+    changed = changed || !location.cached;
+
+    for (Library &library : location.libraries) {
+      std::string fileName =
+        boost::filesystem::path (library.path).filename ().string ();
+
+      if (isSkipped (library) ) {
+        loadReport.skipped++;
+        continue;
+      }
+
+      /* As ModuleManager, only the first library with a file name is used */
+      if (!fileNames.insert (fileName).second) {
+        GST_DEBUG ("Module %s already loaded, ignoring %s", fileName.c_str (),
+                   library.path.c_str () );
+        continue;
+      }
+
+      changed = changed || !library.known;
+
+      auto before = moduleManager.getModules ();
+      auto loadStart = std::chrono::steady_clock::now ();
+
+      moduleManager.loadModule (library.path);
+
+      auto duration = std::chrono::steady_clock::now () - loadStart;
+      std::string module = getNewModule (before);
+
+      /* Failed loads are not cached, so they are retried on next start */
+      bool known = !module.empty () || isLoadable (library.path);
+
+      if (library.known && (module != library.module || !known) ) {
+        changed = true;
+      }
+
+      library.module = module;
+      library.known = known;
+
+      loadReport.modules.push_back ({library.path, module,
+                                     std::chrono::duration_cast<std::chrono::microseconds> (duration)
+                                    });
+
+      if (!module.empty () ) {
+        GST_INFO ("Loaded module %s from %s in %.2f ms", module.c_str (),
+                  library.path.c_str (), toMs (duration) );
+      } else if (library.known) {
+        GST_DEBUG ("Library %s is not a module, checked in %.2f ms",
+                   library.path.c_str (), toMs (duration) );
+      } else {
+        GST_WARNING ("Library %s cannot be loaded, it will be tried again on "
+                     "next start", library.path.c_str () );
+      }
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now ();
+
+  loadReport.discovery =
+    std::chrono::duration_cast<std::chrono::microseconds> (discovered - start);
+  loadReport.prefetch =
+    std::chrono::duration_cast<std::chrono::microseconds> (prefetched -
+        discovered);
+  loadReport.load =
+    std::chrono::duration_cast<std::chrono::microseconds> (end - prefetched);
+  loadReport.manifestUsed = !changed;
+
+  GST_INFO ("Loaded %zu modules in %.2f ms (discovery: %.2f ms, prefetch: "
+            "%.2f ms, load: %.2f ms, %zu libraries skipped by manifest)",
+            moduleManager.getModules ().size (), toMs (end - start),
+            toMs (discovered - start), toMs (prefetched - discovered),
+            toMs (end - prefetched), loadReport.skipped);
+
+  if (changed) {
+    writeManifest (manifestFile, locations);
+  }
 }
 
 } /* kurento */
+
+static void init_debug() __attribute__((constructor));
+
+static void init_debug() {
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+                           GST_DEFAULT_NAME);
+}
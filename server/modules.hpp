@@ -20,11 +20,40 @@
 
 #include <ModuleManager.hpp>
 
+#include <chrono>
+#include <string>
+#include <vector>
+
 namespace kurento
 {
 
+/* Time spent loading the modules, filled by loadModules */
+struct ModulesLoadReport {
+  struct Module {
+    std::string path;
+    /* Empty if the library is not a Kurento module */
+    std::string name;
+    std::chrono::microseconds duration;
+  };
+
+  std::chrono::microseconds discovery{};
+  std::chrono::microseconds prefetch{};
+  std::chrono::microseconds load{};
+  /* Libraries of the manifest that were skipped as known non modules */
+  size_t skipped = 0;
+  bool manifestUsed = false;
+  std::vector<Module> modules;
+};
+
 ModuleManager &getModuleManager ();
-void loadModules (const std::string &path);
+
+/* Loads the modules found in the colon-separated path and in the default
+ * modules directory. Discovered libraries are recorded in the manifest file,
+ * so later startups do not need to walk unchanged directories nor open
+ * libraries that are not modules. An empty manifest uses the default one */
+void loadModules (const std::string &path, const std::string &manifest = "");
+
+const ModulesLoadReport &getModulesLoadReport ();
 
 } /* kurento */
 
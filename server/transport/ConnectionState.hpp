@@ -0,0 +1,101 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __CONNECTION_STATE_HPP__
+#define __CONNECTION_STATE_HPP__
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace kurento
+{
+
+/*
+ * State of a client connection, owned by the connection itself, so the
+ * sessionId of a connection is read without looking it up in a shared map.
+ * It can be read and written from any thread: the sessionId is guarded by a
+ * lock of its own, only contended by the threads handling this connection,
+ * and the other members are atomic.
+ */
+class ConnectionState
+{
+public:
+  /* Encoding of the messages, negotiated on the handshake */
+  enum class Encoding {
+    JSON,
+    CBOR
+  };
+
+  ConnectionState () {};
+  virtual ~ConnectionState () {};
+
+  std::string getSessionId () const
+  {
+    std::unique_lock<std::mutex> lock (sessionIdMutex);
+
+    return sessionId;
+  }
+
+  void setSessionId (const std::string &id)
+  {
+    std::unique_lock<std::mutex> lock (sessionIdMutex);
+
+    sessionId = id;
+  }
+
+  bool isSecure () const
+  {
+    return secure;
+  }
+
+  void setSecure (bool secure)
+  {
+    this->secure = secure;
+  }
+
+  Encoding getEncoding () const
+  {
+    return encoding;
+  }
+
+  void setEncoding (Encoding encoding)
+  {
+    this->encoding = encoding;
+  }
+
+  bool isClosed () const
+  {
+    return closed;
+  }
+
+  void setClosed ()
+  {
+    closed = true;
+  }
+
+private:
+  mutable std::mutex sessionIdMutex;
+  std::string sessionId;
+  std::atomic<bool> secure{};
+  std::atomic<Encoding> encoding{Encoding::JSON};
+  std::atomic<bool> closed{};
+};
+
+} /* kurento */
+
+#endif /* __CONNECTION_STATE_HPP__ */
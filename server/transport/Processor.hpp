@@ -19,6 +19,7 @@
 #define __PROCESSOR_HPP__
 
 #include <MediaObjectImpl.hpp>
+#include "ConnectionState.hpp"
 
 namespace kurento
 {
@@ -41,6 +42,24 @@ public:
   virtual std::string process (const std::string &request, std::string &response,
                                std::string &sessionId) = 0;
 
+  /**
+   * Process a request received on a connection
+   *
+   * @param request The request to be proccessed
+   * @param response The response to be send
+   * @param connection The state of the connection that received the request,
+   *                   its sessionId is used as the one of the channel
+   *
+   * @returns The sessionId of the request
+   */
+  virtual std::string process (const std::string &request, std::string &response,
+                               const std::shared_ptr<ConnectionState> &connection)
+  {
+    std::string sessionId = connection->getSessionId ();
+
+    return process (request, response, sessionId);
+  }
+
   virtual void keepAliveSession (const std::string &sessionId) = 0;
   virtual void setEventSubscriptionHandler (std::function < std::string (
         std::shared_ptr<MediaObjectImpl> obj,
@@ -52,6 +71,16 @@ public:
   virtual void registerEventHandler (std::shared_ptr<MediaObjectImpl> obj,
                                      const std::string &sessionId, const  std::string &subscriptionId,
                                      std::shared_ptr<EventHandler> handler) = 0;
+  /* Lets the transport add its own metrics to the server stats */
+  virtual void setStatsHandler (std::function < void (const Json::Value &params,
+                                Json::Value &stats) > statsHandler) = 0;
+  /* Lets the transport run independent work of a request, such as the
+   * entries of a batch, on its worker threads */
+  virtual void setExecutor (std::function < void (std::function<void ()>) >
+                            executor) = 0;
+  /* Fills a compact summary of the server load, published to the registrar
+   * so that new sessions can be balanced among servers */
+  virtual void getLoadReport (Json::Value &report) = 0;
 };
 
 } /* kurento */
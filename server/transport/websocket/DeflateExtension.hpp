@@ -0,0 +1,171 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __DEFLATE_EXTENSION_HPP__
+#define __DEFLATE_EXTENSION_HPP__
+
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace kurento
+{
+
+/*
+ * permessage-deflate extension with a configurable compression level.
+ *
+ * Negotiation and decompression are those of websocketpp. As its compressor
+ * always uses the zlib default level, messages are compressed with an own
+ * deflate stream when another level is configured, honoring the negotiated
+ * server_max_window_bits and server_no_context_takeover parameters.
+ *
+ * Settings are global, they must be set before accepting connections.
+ */
+template <typename config>
+class DeflateExtension : public
+  websocketpp::extensions::permessage_deflate::enabled<config>
+{
+  typedef websocketpp::extensions::permessage_deflate::enabled<config> base;
+
+public:
+  DeflateExtension () = default;
+
+  ~DeflateExtension ()
+  {
+    if (stream) {
+      deflateEnd (stream.get () );
+    }
+  }
+
+  static void setEnabled (bool value)
+  {
+    enabledSetting = value;
+  }
+
+  static void setLevel (int value)
+  {
+    levelSetting = value;
+  }
+
+  websocketpp::extensions::err_str_pair negotiate (
+    websocketpp::http::attribute_list const &offer)
+  {
+    websocketpp::extensions::err_str_pair ret;
+
+    if (!enabledSetting) {
+      ret.first = websocketpp::extensions::permessage_deflate::error::make_error_code
+                  (websocketpp::extensions::permessage_deflate::error::general);
+      return ret;
+    }
+
+    ret = base::negotiate (offer);
+
+    if (ret.first) {
+      return ret;
+    }
+
+    /* Parameters accepted for our side are those of the response */
+    const std::string windowBitsParam = "server_max_window_bits=";
+    size_t pos = ret.second.find (windowBitsParam);
+
+    noContextTakeover =
+      ret.second.find ("server_no_context_takeover") != std::string::npos;
+
+    if (pos != std::string::npos) {
+      windowBits = std::stoi (ret.second.substr (pos + windowBitsParam.size () ) );
+    }
+
+    return ret;
+  }
+
+  websocketpp::lib::error_code init (bool is_server)
+  {
+    websocketpp::lib::error_code ec = base::init (is_server);
+    int level = levelSetting;
+
+    if (ec || level == Z_DEFAULT_COMPRESSION) {
+      return ec;
+    }
+
+    stream.reset (new z_stream () );
+
+    /* zlib does not support raw deflate windows of 8 bits */
+    if (deflateInit2 (stream.get (), level, Z_DEFLATED,
+                      -std::max (windowBits, 9), 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      stream.reset ();
+      return websocketpp::extensions::permessage_deflate::error::make_error_code
+             (websocketpp::extensions::permessage_deflate::error::zlib_error);
+    }
+
+    return ec;
+  }
+
+  websocketpp::lib::error_code compress (std::string const &in,
+                                         std::string &out)
+  {
+    unsigned char buffer[16384];
+
+    if (!stream) {
+      return base::compress (in, out);
+    }
+
+    if (in.empty () ) {
+      /* Empty stored block, as websocketpp does */
+      const char empty[6] = {0x02, 0x00, 0x00, 0x00, (char) 0xff, (char) 0xff};
+
+      out.append (empty, sizeof (empty) );
+      return websocketpp::lib::error_code ();
+    }
+
+    stream->avail_in = in.size ();
+    stream->next_in = (unsigned char *) const_cast<char *> (in.data () );
+
+    do {
+      stream->avail_out = sizeof (buffer);
+      stream->next_out = buffer;
+
+      deflate (stream.get (), noContextTakeover ? Z_FULL_FLUSH : Z_SYNC_FLUSH);
+
+      out.append ( (char *) buffer, sizeof (buffer) - stream->avail_out);
+    } while (stream->avail_out == 0);
+
+    return websocketpp::lib::error_code ();
+  }
+
+private:
+  std::unique_ptr<z_stream> stream;
+  int windowBits = 15;
+  bool noContextTakeover = false;
+
+  static std::atomic<bool> enabledSetting;
+  static std::atomic<int> levelSetting;
+};
+
+template <typename config>
+std::atomic<bool> DeflateExtension<config>::enabledSetting{false};
+
+template <typename config>
+std::atomic<int> DeflateExtension<config>::levelSetting{Z_DEFAULT_COMPRESSION};
+
+} /* kurento */
+
+#endif /* __DEFLATE_EXTENSION_HPP__ */
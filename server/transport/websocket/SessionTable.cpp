@@ -0,0 +1,152 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "SessionTable.hpp"
+
+#include <algorithm>
+
+#define SESSION_TABLE_SHARDS 16
+
+namespace kurento
+{
+
+bool
+SessionTable::Session::isUnused () const
+{
+  /* A running flush still writes its events and clears the flag */
+  if (!connection.expired () || !strand.expired () || flushing) {
+    return false;
+  }
+
+  for (auto &handler : handlers) {
+    if (!handler.second.expired () ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+SessionTable::SessionTable ()
+{
+  for (int i = 0; i < SESSION_TABLE_SHARDS; i++) {
+    shards.emplace_back (new Shard () );
+  }
+}
+
+SessionTable::Shard &
+SessionTable::getShard (const std::string &sessionId)
+{
+  return *shards[std::hash<std::string>() (sessionId) % shards.size()];
+}
+
+bool
+SessionTable::isSameConnection (const websocketpp::connection_hdl &a,
+                                const websocketpp::connection_hdl &b)
+{
+  return !a.owner_before (b) && !b.owner_before (a);
+}
+
+void
+SessionTable::release (const std::string &sessionId,
+                       websocketpp::connection_hdl connection)
+{
+  Shard &shard = getShard (sessionId);
+  std::unique_lock<std::mutex> lock (shard.mutex);
+  auto it = shard.sessions.find (sessionId);
+
+  if (it == shard.sessions.end () ) {
+    return;
+  }
+
+  if (isSameConnection (it->second.connection, connection) ) {
+    it->second.connection.reset ();
+    it->second.events.clear ();
+  }
+
+  if (it->second.isUnused () ) {
+    shard.sessions.erase (it);
+  }
+}
+
+size_t
+SessionTable::purge ()
+{
+  size_t removed = 0;
+
+  for (auto &shard : shards) {
+    std::unique_lock<std::mutex> lock (shard->mutex);
+
+    for (auto it = shard->sessions.begin (); it != shard->sessions.end ();) {
+      Session &session = it->second;
+
+      for (auto handler = session.handlers.begin ();
+           handler != session.handlers.end ();) {
+        if (handler->second.expired () ) {
+          handler = session.handlers.erase (handler);
+        } else {
+          handler++;
+        }
+      }
+
+      if (session.isUnused () ) {
+        it = shard->sessions.erase (it);
+        removed++;
+      } else {
+        it++;
+      }
+    }
+  }
+
+  return removed;
+}
+
+std::vector<std::string>
+SessionTable::getConnectedSessions ()
+{
+  std::vector<std::string> sessionIds;
+
+  for (auto &shard : shards) {
+    std::unique_lock<std::mutex> lock (shard->mutex);
+
+    for (auto &session : shard->sessions) {
+      if (!session.second.connection.expired () ) {
+        sessionIds.push_back (session.first);
+      }
+    }
+  }
+
+  return sessionIds;
+}
+
+void
+SessionTable::getQueueDepth (size_t &total, size_t &max)
+{
+  total = 0;
+  max = 0;
+
+  for (auto &shard : shards) {
+    std::unique_lock<std::mutex> lock (shard->mutex);
+
+    for (auto &session : shard->sessions) {
+      total += session.second.events.size ();
+      max = std::max (max, session.second.events.size () );
+    }
+  }
+}
+
+} /* kurento */
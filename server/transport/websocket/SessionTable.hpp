@@ -0,0 +1,135 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __SESSION_TABLE_HPP__
+#define __SESSION_TABLE_HPP__
+
+#include <EventHandler.hpp>
+
+#include <websocketpp/common/connection_hdl.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kurento
+{
+
+/*
+ * Per session state of the WebSocket transport. Sessions are stored in a
+ * fixed number of shards, selected by hashing the sessionId, each one
+ * protected by its own lock, so sending an event only contends with
+ * operations on sessions of the same shard.
+ */
+class SessionTable
+{
+public:
+  struct Message {
+    std::shared_ptr<const std::string> payload;
+    bool binary;
+  };
+
+  struct Session {
+    websocketpp::connection_hdl connection;
+    bool secure = false;
+    /* Encoding negotiated by the connection, CBOR if true */
+    bool binary = false;
+    std::weak_ptr<boost::asio::io_service::strand> strand;
+    /* Keyed by "objectId|eventType" */
+    std::map<std::string, std::weak_ptr<EventHandler>> handlers;
+    /* Serialized events waiting to be written by an I/O thread */
+    std::deque<Message> events;
+    bool flushing = false;
+    /* Events accepted for delivery and their size */
+    uint64_t emittedEvents = 0;
+    uint64_t emittedBytes = 0;
+
+    bool isUnused () const;
+  };
+
+  SessionTable ();
+
+  /* Calls func with the session locked; returns false if it does not exist */
+  template <typename Func>
+  bool find (const std::string &sessionId, Func func);
+
+  /* Calls func with the session locked, creating it if it does not exist */
+  template <typename Func>
+  void modify (const std::string &sessionId, Func func);
+
+  /* Detaches the connection from the session, discarding its queued events.
+   * The session is removed if unused */
+  void release (const std::string &sessionId,
+                websocketpp::connection_hdl connection);
+
+  /* Drops handlers already released and removes the sessions left unused,
+   * as those whose subscriptions outlived their connection */
+  size_t purge ();
+
+  std::vector<std::string> getConnectedSessions ();
+  void getQueueDepth (size_t &total, size_t &max);
+
+  static bool isSameConnection (const websocketpp::connection_hdl &a,
+                                const websocketpp::connection_hdl &b);
+
+private:
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Session> sessions;
+  };
+
+  Shard &getShard (const std::string &sessionId);
+
+  std::vector<std::unique_ptr<Shard>> shards;
+};
+
+template <typename Func>
+bool
+SessionTable::find (const std::string &sessionId, Func func)
+{
+  Shard &shard = getShard (sessionId);
+  std::unique_lock<std::mutex> lock (shard.mutex);
+  auto it = shard.sessions.find (sessionId);
+
+  if (it == shard.sessions.end () ) {
+    return false;
+  }
+
+  func (it->second);
+
+  return true;
+}
+
+template <typename Func>
+void
+SessionTable::modify (const std::string &sessionId, Func func)
+{
+  Shard &shard = getShard (sessionId);
+  std::unique_lock<std::mutex> lock (shard.mutex);
+
+  func (shard.sessions[sessionId]);
+}
+
+} /* kurento */
+
+#endif /* __SESSION_TABLE_HPP__ */
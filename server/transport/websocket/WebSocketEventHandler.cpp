@@ -16,6 +16,8 @@
  */
 
 #include "WebSocketEventHandler.hpp"
+#include "JsonUtils.hpp"
+#include "CborUtils.hpp"
 
 #include <gst/gst.h>
 #include <json/json.h>
@@ -31,35 +33,134 @@ namespace kurento
 
 WebSocketEventHandler::WebSocketEventHandler(
     std::shared_ptr<MediaObjectImpl> object,
-    std::shared_ptr<WebSocketTransport> transport, std::string sessionId)
-    : EventHandler(object), transport(std::move(transport)),
-      sessionId(std::move(sessionId)) {}
+    std::shared_ptr<WebSocketTransport> transport, const std::string &eventId)
+    : EventHandler(object), transport(std::move(transport)), eventId (eventId),
+      envelope (getEnvelope () ), binaryEnvelope (getBinaryEnvelope () ) {}
+
+WebSocketEventHandler::~WebSocketEventHandler ()
+{
+  transport->releaseEventHandler (eventId);
+}
+
+WebSocketEventHandler::Envelope::Envelope (bool binary)
+{
+  /* Encodings of null. In CBOR the value is the last item of the message,
+   * as members are written sorted, so the suffix is empty */
+  const std::string placeholder = binary ? "\xf6" : "null";
+  Json::Value rpc;
+  Json::Value event;
+  std::string eventStr;
+
+  event ["value"] = Json::Value::null;
+
+  rpc [JSON_RPC_PROTO] = JSON_RPC_PROTO_VERSION;
+  rpc [JSON_RPC_METHOD] = "onEvent";
+  rpc [JSON_RPC_PARAMS] = event;
+
+  if (binary) {
+    writeCbor (rpc, eventStr);
+  } else {
+    writeJson (rpc, eventStr);
+  }
+
+  size_t pos = eventStr.rfind (placeholder);
+
+  prefix = eventStr.substr (0, pos);
+  suffix = eventStr.substr (pos + placeholder.size () );
+}
+
+std::shared_ptr<const std::string>
+WebSocketEventHandler::Envelope::build (const std::string &value) const
+{
+  std::shared_ptr<std::string> event = std::make_shared<std::string> ();
+
+  event->reserve (prefix.size () + value.size () + suffix.size () );
+  event->append (prefix);
+  event->append (value);
+  event->append (suffix);
+
+  return event;
+}
+
+const WebSocketEventHandler::Envelope &
+WebSocketEventHandler::getEnvelope ()
+{
+  static const Envelope envelope (false);
+
+  return envelope;
+}
+
+const WebSocketEventHandler::Envelope &
+WebSocketEventHandler::getBinaryEnvelope ()
+{
+  static const Envelope envelope (true);
+
+  return envelope;
+}
+
+void
+WebSocketEventHandler::addSubscriber (const std::string &sessionId,
+                                      std::shared_ptr<EventHandler> subscription)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  subscribers[sessionId] = subscription;
+}
 
 void
 WebSocketEventHandler::sendEvent (Json::Value &value)
 {
   try {
-    Json::Value rpc;
-    Json::Value event;
-    std::string eventStr;
-
-    event ["value"] = value;
-
-    rpc [JSON_RPC_PROTO] = JSON_RPC_PROTO_VERSION;
-    rpc [JSON_RPC_METHOD] = "onEvent";
-    rpc [JSON_RPC_PARAMS] = event;
-
-    Json::StreamWriterBuilder writerFactory;
-    writerFactory["indentation"] = "";
-    eventStr = Json::writeString (writerFactory, rpc);
-    GST_DEBUG ("Sending event: %s, sessionId: %s", eventStr.c_str(),
-               sessionId.c_str() );
-
-    try {
-      transport->send (sessionId, eventStr);
-    } catch (websocketpp::exception &e) {
-      GST_ERROR ("Error on websocket while sending event to MediaHandler: %s",
-                 e.code().message().c_str() );
+    /* Reused by every event raised on this thread */
+    static thread_local std::string valueStr;
+    std::shared_ptr<const std::string> eventStr;
+    std::shared_ptr<const std::string> binaryEvent;
+    std::vector<std::string> sessionIds;
+
+    {
+      std::unique_lock<std::mutex> lock (mutex);
+
+      for (auto it = subscribers.begin (); it != subscribers.end (); ) {
+        if (it->second.expired () ) {
+          it = subscribers.erase (it);
+        } else {
+          sessionIds.push_back (it->first);
+          it++;
+        }
+      }
+    }
+
+    if (sessionIds.empty () ) {
+      return;
+    }
+
+    writeJson (value, valueStr);
+    eventStr = envelope.build (valueStr);
+
+    /* Encoded once, the first time a session connected with the binary
+     * subprotocol is sent to */
+    WebSocketTransport::Encoder encodeBinary = [&] () {
+      if (!binaryEvent) {
+        writeCbor (value, valueStr);
+        binaryEvent = binaryEnvelope.build (valueStr);
+      }
+
+      return binaryEvent;
+    };
+
+    GST_DEBUG ("Sending event: %s, to %zu sessions", eventStr->c_str(),
+               sessionIds.size () );
+
+    for (const std::string &sessionId : sessionIds) {
+      try {
+        transport->send (sessionId, eventStr, encodeBinary);
+      } catch (websocketpp::exception &e) {
+        GST_ERROR ("Error on websocket while sending event to MediaHandler: %s",
+                   e.code().message().c_str() );
+      } catch (std::exception &e) {
+        GST_WARNING ("Error sending event to session %s: %s", sessionId.c_str (),
+                     e.what() );
+      }
     }
   } catch (std::exception &e) {
     GST_WARNING ("Error sending event to MediaHandler: %s", e.what() );
@@ -20,22 +20,56 @@
 
 #include "WebSocketTransport.hpp"
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 namespace kurento
 {
 
+/*
+ * Connected once to an event of an object, it serializes every event once
+ * and delivers the same buffer to all the subscribed sessions. Events are
+ * also encoded as CBOR, once, if any of those sessions is connected with the
+ * binary subprotocol.
+ */
 class WebSocketEventHandler : public EventHandler
 {
 public:
   WebSocketEventHandler (std::shared_ptr <MediaObjectImpl> object,
-                         std::shared_ptr<WebSocketTransport> transport, std::string sessionId);
-  virtual ~WebSocketEventHandler () {};
+                         std::shared_ptr<WebSocketTransport> transport,
+                         const std::string &eventId);
+  virtual ~WebSocketEventHandler ();
 
   virtual void sendEvent (Json::Value &value);
 
+  /* The session receives events while subscription is alive */
+  void addSubscriber (const std::string &sessionId,
+                      std::shared_ptr<EventHandler> subscription);
+
 private:
 
+  /* onEvent notification serialized around a placeholder value, so that
+   * only the value of each event needs to be serialized */
+  struct Envelope {
+    Envelope (bool binary);
+
+    std::shared_ptr<const std::string> build (const std::string &value) const;
+
+    std::string prefix;
+    std::string suffix;
+  };
+
+  static const Envelope &getEnvelope ();
+  static const Envelope &getBinaryEnvelope ();
+
   std::shared_ptr<WebSocketTransport> transport;
-  std::string sessionId;
+  std::string eventId;
+  const Envelope &envelope;
+  const Envelope &binaryEnvelope;
+
+  std::mutex mutex;
+  std::map<std::string, std::weak_ptr<EventHandler>> subscribers;
 
   class StaticConstructor
   {
@@ -46,6 +80,25 @@ private:
   static StaticConstructor staticConstructor;
 };
 
+/*
+ * Subscription of a session to a WebSocketEventHandler. This is what the
+ * MediaSet keeps for every subscription of the session; events are delivered
+ * by the shared handler while it is alive.
+ */
+class WebSocketEventSubscription : public EventHandler
+{
+public:
+  WebSocketEventSubscription (std::shared_ptr <MediaObjectImpl> object,
+                              std::shared_ptr<WebSocketEventHandler> handler)
+    : EventHandler (object), handler (handler) {};
+  virtual ~WebSocketEventSubscription () {};
+
+  virtual void sendEvent (Json::Value &value) {};
+
+private:
+  std::shared_ptr<WebSocketEventHandler> handler;
+};
+
 } /* kurento */
 
 #endif /* __WEBSOCKET_EVENT_HANDLER_HPP__ */
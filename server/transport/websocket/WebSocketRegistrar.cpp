@@ -96,6 +96,14 @@ WebSocketRegistrar::stop()
   }
 }
 
+void
+WebSocketRegistrar::setLoadReport (std::chrono::milliseconds period,
+                                   std::function<void (Json::Value &report) > handler)
+{
+  loadReportPeriod = period;
+  loadReportHandler = handler;
+}
+
 void
 WebSocketRegistrar::connectRegistrar ()
 {
@@ -187,6 +195,9 @@ WebSocketRegistrar::connectRegistrar ()
       }
     }
 
+    /* The timer can not outlive the io_service of this connection */
+    loadReportTimer.reset ();
+
     if (finished) {
       break;
     }
@@ -243,6 +254,13 @@ WebSocketRegistrar::connectionOpen (std::shared_ptr<ClientType> client,
     client->send (hdl, request, websocketpp::frame::opcode::TEXT);
   } catch (websocketpp::exception &e) {
     GST_ERROR ("Cannot send message to remote");
+    return;
+  }
+
+  if (loadReportHandler && loadReportPeriod.count () > 0) {
+    loadReportTimer = std::make_shared<boost::asio::steady_timer>
+                      (client->get_io_service () );
+    scheduleLoadReport (client, hdl);
   }
 }
 
@@ -250,6 +268,65 @@ void
 WebSocketRegistrar::closedHandler (websocketpp::connection_hdl hdl)
 {
   GST_DEBUG ("Registrar closed");
+
+  if (loadReportTimer) {
+    loadReportTimer->cancel ();
+  }
+}
+
+template <typename ClientType>
+void
+WebSocketRegistrar::scheduleLoadReport (std::shared_ptr<ClientType> client,
+                                        websocketpp::connection_hdl hdl)
+{
+  loadReportTimer->expires_from_now (loadReportPeriod);
+  loadReportTimer->async_wait ([this, client, hdl] (
+  const boost::system::error_code & ec) {
+    if (ec || finished || !loadReportTimer) {
+      return;
+    }
+
+    if (sendLoadReport (client, hdl) ) {
+      scheduleLoadReport (client, hdl);
+    }
+  });
+}
+
+/* Sent as a notification, registrars not aware of it can ignore it */
+template <typename ClientType>
+bool
+WebSocketRegistrar::sendLoadReport (std::shared_ptr<ClientType> client,
+                                    websocketpp::connection_hdl hdl)
+{
+  websocketpp::lib::error_code ec;
+  Json::Value notification;
+  Json::Value report;
+  std::string message;
+
+  try {
+    loadReportHandler (report);
+  } catch (std::exception &e) {
+    GST_WARNING ("Cannot get load report: %s", e.what () );
+    return true;
+  }
+
+  notification["jsonrpc"] = "2.0";
+  notification["method"] = "loadReport";
+  notification["params"] = report;
+
+  Json::StreamWriterBuilder writerFactory;
+  writerFactory["indentation"] = "";
+  message = Json::writeString (writerFactory, notification);
+  GST_TRACE ("Sending load report: %s", message.c_str() );
+
+  client->send (hdl, message, websocketpp::frame::opcode::TEXT, ec);
+
+  if (ec) {
+    GST_DEBUG ("Cannot send load report: %s", ec.message ().c_str () );
+    return false;
+  }
+
+  return true;
 }
 
 template <typename ClientType>
@@ -20,8 +20,11 @@
 
 #include <websocketpp/client.hpp>
 #include <websocketpp/config/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <json/json.h>
 #include <thread>
 #include <atomic>
+#include <functional>
 
 namespace kurento
 {
@@ -41,6 +44,11 @@ public:
   void start ();
   void stop ();
 
+  /* Publishes the report filled by handler every period while registered.
+   * Must be called before start */
+  void setLoadReport (std::chrono::milliseconds period,
+                      std::function<void (Json::Value &report) > handler);
+
 private:
 
   std::string localAddress;
@@ -59,6 +67,11 @@ private:
 
   websocketpp::connection_hdl connection;
 
+  std::chrono::milliseconds loadReportPeriod{};
+  std::function<void (Json::Value &report) > loadReportHandler;
+  /* Only used from the thread of the client */
+  std::shared_ptr<boost::asio::steady_timer> loadReportTimer;
+
   std::shared_ptr<WebSocketClient> client;
   std::shared_ptr<SecureWebSocketClient> secureClient;
 
@@ -71,6 +84,12 @@ private:
                         websocketpp::connection_hdl hdl,
                         typename ClientType::message_ptr msg);
   void closedHandler (websocketpp::connection_hdl hdl);
+  template <typename ClientType>
+  void scheduleLoadReport (std::shared_ptr<ClientType> client,
+                           websocketpp::connection_hdl hdl);
+  template <typename ClientType>
+  bool sendLoadReport (std::shared_ptr<ClientType> client,
+                       websocketpp::connection_hdl hdl);
 
   class StaticConstructor
   {
@@ -20,6 +20,8 @@
 #include "WebSocketTransport.hpp"
 #include "WebSocketEventHandler.hpp"
 #include "WebSocketRegistrar.hpp"
+#include "JsonUtils.hpp"
+#include "CborUtils.hpp"
 #include <jsonrpc/JsonRpcUtils.hpp>
 #include <jsonrpc/JsonRpcConstants.hpp>
 #include <KurentoException.hpp>
@@ -29,6 +31,7 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/asio/ip/basic_endpoint.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/optional.hpp>
 
 #include <memory>
@@ -49,6 +52,16 @@ const std::string DEFAULT_LOCAL_ADDRESS = "localhost";
 const bool WEBSOCKET_IPV6_DEFAULT = true;
 const std::string WEBSOCKET_PATH_DEFAULT = "kurento";
 const int WEBSOCKET_THREADS_DEFAULT = 10;
+const int WEBSOCKET_MAX_PENDING_REQUESTS_DEFAULT = 1000;
+const size_t WEBSOCKET_EVENT_QUEUE_SIZE_DEFAULT = 1000;
+const std::string WEBSOCKET_EVENT_QUEUE_OVERFLOW_DEFAULT = "drop";
+const size_t WEBSOCKET_EVENT_QUEUE_MAX_BUFFERED_DEFAULT = 1024 * 1024;
+/* Period to retry writing events to a connection with too many bytes pending */
+const std::chrono::milliseconds WEBSOCKET_EVENT_FLUSH_RETRY (10);
+const bool WEBSOCKET_COMPRESSION_DEFAULT = false;
+const size_t WEBSOCKET_COMPRESSION_THRESHOLD_DEFAULT = 1024;
+const int WEBSOCKET_COMPRESSION_LEVEL_DEFAULT = Z_DEFAULT_COMPRESSION;
+const std::string WEBSOCKET_CBOR_SUBPROTOCOL = "kurento.cbor";
 const int WEBSOCKET_CONNQUEUE_DEFAULT =
   boost::asio::socket_base::max_connections;
 
@@ -73,9 +86,82 @@ WebSocketTransport::WebSocketTransport (
     n_threads = WEBSOCKET_THREADS_DEFAULT;
   }
 
+  try {
+    n_rpcThreads = config.get<uint> ("mediaServer.net.websocket.rpcThreads");
+
+    if (n_rpcThreads < 1) {
+      throw boost::property_tree::ptree_bad_data (
+          "Invalid threads number", n_rpcThreads);
+    }
+  } catch (const boost::property_tree::ptree_error &err) {
+    n_rpcThreads = std::thread::hardware_concurrency ();
+
+    if (n_rpcThreads < 1) {
+      n_rpcThreads = WEBSOCKET_THREADS_DEFAULT;
+    }
+  }
+
+  maxPendingRequests = config.get<int> (
+      "mediaServer.net.websocket.maxPendingRequests",
+      WEBSOCKET_MAX_PENDING_REQUESTS_DEFAULT);
+
+  GST_INFO ("Using %d WebSocket I/O threads and %d RPC worker threads",
+      n_threads, n_rpcThreads);
+
+  maxEventQueue = config.get<size_t> (
+      "mediaServer.net.websocket.eventQueueSize",
+      WEBSOCKET_EVENT_QUEUE_SIZE_DEFAULT);
+
+  maxEventBuffered = config.get<size_t> (
+      "mediaServer.net.websocket.eventQueueMaxBuffered",
+      WEBSOCKET_EVENT_QUEUE_MAX_BUFFERED_DEFAULT);
+
+  std::string overflow = config.get<std::string> (
+      "mediaServer.net.websocket.eventQueueOverflow",
+      WEBSOCKET_EVENT_QUEUE_OVERFLOW_DEFAULT);
+
+  if (overflow != "drop" && overflow != "close") {
+    GST_WARNING ("Invalid event queue overflow policy '%s', using '%s'",
+        overflow.c_str (), WEBSOCKET_EVENT_QUEUE_OVERFLOW_DEFAULT.c_str ());
+    overflow = WEBSOCKET_EVENT_QUEUE_OVERFLOW_DEFAULT;
+  }
+
+  closeOnEventQueueOverflow = (overflow == "close");
+
+  bool compression = config.get<bool> (
+      "mediaServer.net.websocket.compression.enabled",
+      WEBSOCKET_COMPRESSION_DEFAULT);
+  int compressionLevel = config.get<int> (
+      "mediaServer.net.websocket.compression.level",
+      WEBSOCKET_COMPRESSION_LEVEL_DEFAULT);
+
+  compressionThreshold = config.get<size_t> (
+      "mediaServer.net.websocket.compression.threshold",
+      WEBSOCKET_COMPRESSION_THRESHOLD_DEFAULT);
+
+  if (compressionLevel < Z_DEFAULT_COMPRESSION
+      || compressionLevel > Z_BEST_COMPRESSION) {
+    GST_WARNING ("Invalid compression level %d, using the default one",
+        compressionLevel);
+    compressionLevel = WEBSOCKET_COMPRESSION_LEVEL_DEFAULT;
+  }
+
+  WebSocketDeflate::setEnabled (compression);
+  WebSocketDeflate::setLevel (compressionLevel);
+
+  if (compression) {
+    GST_INFO ("permessage-deflate enabled, level %d, for messages from %zu bytes",
+        compressionLevel, compressionThreshold);
+  }
+
   processor->setEventSubscriptionHandler (std::bind (
       &WebSocketTransport::processSubscription, this, std::placeholders::_1,
       std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+  processor->setStatsHandler (std::bind (&WebSocketTransport::getStats, this,
+      std::placeholders::_1, std::placeholders::_2));
+  processor->setExecutor ([this] (std::function<void ()> task) {
+    rpcIos.post (task);
+  });
 
   /* Configure insecure WebSocket server, if enabled */
   initWebSocket (config);
@@ -101,7 +187,7 @@ WebSocketTransport::WebSocketTransport (
 
 WebSocketTransport::~WebSocketTransport() noexcept = default;
 
-void WebSocketTransport::run()
+void WebSocketTransport::run (boost::asio::io_service &service)
 {
   bool running = true;
 
@@ -109,7 +195,7 @@ void WebSocketTransport::run()
 
   while (running) {
     try {
-      ios.run();
+      service.run();
       running = false;
     } catch (std::exception &e) {
       GST_ERROR ("Unexpected error while running the server: %s", e.what() );
@@ -142,13 +228,21 @@ WebSocketTransport::initWebSocket (const boost::property_tree::ptree &config)
   server.set_reuse_addr (true);
   server.set_listen_backlog (connqueue);
 
+  server.set_validate_handler (
+      std::bind ((bool (WebSocketTransport::*) (
+                     WebSocketServer *, websocketpp::connection_hdl))
+              & WebSocketTransport::validateHandler,
+          this, &server, std::placeholders::_1));
   server.set_open_handler (
       std::bind ((void (WebSocketTransport::*) (
                      WebSocketServer *, websocketpp::connection_hdl))
               & WebSocketTransport::openHandler,
           this, &server, std::placeholders::_1));
-  server.set_close_handler (std::bind (
-      &WebSocketTransport::closeHandler, this, std::placeholders::_1));
+  server.set_close_handler (
+      std::bind ((void (WebSocketTransport::*) (
+                     WebSocketServer *, websocketpp::connection_hdl))
+              & WebSocketTransport::closeHandler,
+          this, &server, std::placeholders::_1));
   server.set_message_handler (
       std::bind ((void (WebSocketTransport::*) (WebSocketServer *,
                      websocketpp::connection_hdl, WebSocketServer::message_ptr))
@@ -257,13 +351,21 @@ WebSocketTransport::initSecureWebSocket (
   secureServer.set_reuse_addr (true);
   secureServer.set_listen_backlog (connqueue);
 
+  secureServer.set_validate_handler (
+      std::bind ((bool (WebSocketTransport::*) (
+                     SecureWebSocketServer *, websocketpp::connection_hdl))
+              & WebSocketTransport::validateHandler,
+          this, &secureServer, std::placeholders::_1));
   secureServer.set_open_handler (
       std::bind ((void (WebSocketTransport::*) (
                      SecureWebSocketServer *, websocketpp::connection_hdl))
               & WebSocketTransport::openHandler,
           this, &secureServer, std::placeholders::_1));
-  secureServer.set_close_handler (std::bind (
-      &WebSocketTransport::closeHandler, this, std::placeholders::_1));
+  secureServer.set_close_handler (
+      std::bind ((void (WebSocketTransport::*) (
+                     SecureWebSocketServer *, websocketpp::connection_hdl))
+              & WebSocketTransport::closeHandler,
+          this, &secureServer, std::placeholders::_1));
   secureServer.set_message_handler (std::bind (
       (void (WebSocketTransport::*) (SecureWebSocketServer *,
           websocketpp::connection_hdl, SecureWebSocketServer::message_ptr))
@@ -348,9 +450,15 @@ WebSocketTransport::initRegistrar (const boost::property_tree::ptree &config)
   const uint16_t securePort =
       config.get<uint16_t> ("mediaServer.net.websocket.secure.port", 0);
 
+  const std::chrono::milliseconds loadReportPeriod (config.get<uint> (
+      "mediaServer.net.websocket.registrar.loadReportPeriod", 0));
+
   if (!registrarAddress.empty () && !localAddress.empty ()) {
     registrar = std::make_shared<WebSocketRegistrar> (
         registrarAddress, localAddress, port, securePort, path);
+    registrar->setLoadReport (loadReportPeriod,
+        std::bind (&WebSocketTransport::getLoadReport, this,
+            std::placeholders::_1));
   }
 }
 
@@ -359,13 +467,16 @@ void WebSocketTransport::keepAliveSessions()
   std::unique_lock<std::recursive_mutex> lock (mutex);
 
   while (isRunning() ) {
-    std::list<std::string> conns;
+    lock.unlock ();
+
+    /* Records are otherwise only removed when their connection closes */
+    size_t purged = sessions.purge ();
 
-    for (auto c : connections) {
-      conns.push_back (c.first);
+    if (purged > 0) {
+      GST_DEBUG ("Purged %zu unused sessions", purged);
     }
 
-    lock.unlock ();
+    std::vector<std::string> conns = sessions.getConnectedSessions ();
 
     for (auto c : conns) {
       GST_DEBUG ("Keep-Alive for session '%s'", c.c_str() );
@@ -410,8 +521,18 @@ void WebSocketTransport::start ()
     secureServer.start_accept ();
   }
 
+  rpcWork.reset (new boost::asio::io_service::work (rpcIos) );
+
+  for (int i = 0; i < n_rpcThreads; i++) {
+    rpcThreads.emplace_back ([this] () {
+      run (rpcIos);
+    });
+  }
+
   for (int i = 0; i < n_threads; i++) {
-    threads.emplace_back(std::bind(&WebSocketTransport::run, this));
+    threads.emplace_back ([this] () {
+      run (ios);
+    });
   }
 
   std::unique_lock<std::recursive_mutex> lock (mutex);
@@ -445,6 +566,13 @@ void WebSocketTransport::stop ()
     threads[i].join();
   }
 
+  /* Let the workers finish the requests already queued */
+  rpcWork.reset ();
+
+  for (int i = 0; i < n_rpcThreads; i++) {
+    rpcThreads[i].join();
+  }
+
   if (registrar) {
     registrar->stop();
   }
@@ -452,60 +580,83 @@ void WebSocketTransport::stop ()
   keepAliveThread.join();
 }
 
-websocketpp::connection_hdl
-WebSocketTransport::getConnection (const std::string &sessionId)
+std::shared_ptr<WebSocketConnectionState>
+WebSocketTransport::getConnectionState (websocketpp::connection_hdl hdl,
+                                        bool secure)
 {
-  try {
-    std::unique_lock<std::recursive_mutex> lock (mutex);
-    return connections.at (sessionId);
-  } catch (std::out_of_range &e) {
-    throw std::out_of_range ("Connection not found for sessionId: " + sessionId);
+  websocketpp::lib::error_code ec;
+  std::shared_ptr<WebSocketConnectionState> state;
+
+  if (secure) {
+    state = secureServer.get_con_from_hdl (hdl, ec);
+  } else {
+    state = server.get_con_from_hdl (hdl, ec);
+  }
+
+  if (ec) {
+    return nullptr;
   }
+
+  return state;
 }
 
-void WebSocketTransport::storeConnection (const std::string &request,
-    const std::string &response, websocketpp::connection_hdl connection,
-    bool secure, std::string &sessionId)
+void WebSocketTransport::storeConnection (websocketpp::connection_hdl
+    connection, WebSocketConnectionState &state, const std::string &sessionId)
 {
   if (!sessionId.empty() ) {
-    std::unique_lock<std::recursive_mutex> lock (mutex);
+    websocketpp::connection_hdl conn;
+    bool connSecure = false;
     bool needsWrite = false;
+    std::string oldSession = state.getSessionId ();
 
-    try {
-      websocketpp::connection_hdl conn = connections.at (sessionId);
-
-      if (conn.lock() != connection.lock() ) {
-        GST_WARNING ("Erasing old connection associated with: %s",
-                     sessionId.c_str() );
-        connectionsReverse.erase (conn);
-        connections.erase (sessionId);
-        secureConnections.erase (sessionId);
-        needsWrite = true;
-      }
-    } catch (std::out_of_range &e) {
-      /* Ignore */
-      needsWrite = true;
+    if (state.isClosed () ) {
+      /* Connection was closed while the request was being processed */
+      return;
     }
 
-    try {
-      std::string oldSession = connectionsReverse.at (connection);
-
-      if (oldSession != sessionId) {
+    if (oldSession != sessionId) {
+      if (!oldSession.empty () ) {
         GST_WARNING ("Erasing old sessionId %s associated with current connection",
                      oldSession.c_str() );
-        connectionsReverse.erase (connection);
-        connections.erase (oldSession);
-        needsWrite = true;
+        sessions.release (oldSession, connection);
       }
 
-    } catch (std::out_of_range &e) {
+      state.setSessionId (sessionId);
       needsWrite = true;
     }
 
+    sessions.modify (sessionId, [&] (SessionTable::Session & session) {
+      if (!SessionTable::isSameConnection (session.connection, connection) ) {
+        conn = session.connection;
+        connSecure = session.secure;
+        session.connection = connection;
+        needsWrite = true;
+      }
+
+      session.secure = state.isSecure ();
+      session.binary = (state.getEncoding () == ConnectionState::Encoding::CBOR);
+    });
+
+    if (state.isClosed () ) {
+      /* Closed meanwhile, closeHandler may have missed the new sessionId */
+      sessions.release (sessionId, connection);
+      return;
+    }
+
+    if (!conn.expired () ) {
+      std::shared_ptr<WebSocketConnectionState> old =
+        getConnectionState (conn, connSecure);
+
+      GST_WARNING ("Erasing old connection associated with: %s",
+                   sessionId.c_str() );
+
+      if (old && old->getSessionId () == sessionId) {
+        old->setSessionId ("");
+      }
+    }
+
     if (needsWrite) {
       GST_DEBUG ("Associating session %s", sessionId.c_str ());
-      connections[sessionId] = connection;
-      connectionsReverse[connection] = sessionId;
 
       try {
         processor->keepAliveSession (sessionId);
@@ -515,8 +666,6 @@ void WebSocketTransport::storeConnection (const std::string &request,
         }
       }
     }
-
-    secureConnections[sessionId] = secure;
   }
 }
 
@@ -524,51 +673,462 @@ void
 WebSocketTransport::send (const std::string &sessionId,
                           const std::string &message)
 {
-  std::unique_lock <std::recursive_mutex> lock (mutex);
-  websocketpp::connection_hdl hdl = getConnection (sessionId);
+  send (sessionId, std::make_shared<const std::string> (message) );
+}
 
-  try {
-    if (secureConnections[sessionId]) {
-      lock.unlock();
-      secureServer.send (hdl, message, websocketpp::frame::opcode::TEXT);
+void
+WebSocketTransport::send (const std::string &sessionId,
+                          std::shared_ptr<const std::string> message,
+                          const Encoder &binaryMessage)
+{
+  websocketpp::connection_hdl hdl;
+  bool secure = false;
+  bool overflow = false;
+  bool schedule = false;
+
+  sessions.find (sessionId, [&] (SessionTable::Session & session) {
+    hdl = session.connection;
+    secure = session.secure;
+
+    if (hdl.expired () ) {
+      return;
+    }
+
+    if (maxEventQueue > 0 && session.events.size () >= maxEventQueue) {
+      overflow = true;
+      return;
+    }
+
+    SessionTable::Message event = {message, false};
+
+    if (session.binary && binaryMessage) {
+      event = {binaryMessage (), true};
+    }
+
+    session.events.push_back (event);
+    session.emittedEvents++;
+    session.emittedBytes += event.payload->size ();
+
+    if (!session.flushing) {
+      session.flushing = true;
+      schedule = true;
+    }
+  });
+
+  if (hdl.expired () ) {
+    throw std::out_of_range ("Connection not found for sessionId: " + sessionId);
+  }
+
+  if (overflow) {
+    eventQueueOverflow (sessionId, hdl, secure);
+  } else if (schedule) {
+    ios.post (std::bind (&WebSocketTransport::flushEvents, this, sessionId) );
+  }
+}
+
+void
+WebSocketTransport::flushEvents (const std::string &sessionId)
+{
+  std::deque<SessionTable::Message> events;
+  websocketpp::connection_hdl hdl;
+  bool secure = false;
+
+  /* The session is flushing until its queue is found empty, so no other
+   * flush of it runs meanwhile and events are written in the order they
+   * were queued */
+  while (true) {
+    events.clear ();
+
+    /* Takes the whole burst queued since the last write, websocketpp
+     * gathers the frames pending on a connection into a single socket
+     * write */
+    sessions.find (sessionId, [&] (SessionTable::Session & session) {
+      events.swap (session.events);
+      session.flushing = !events.empty ();
+      hdl = session.connection;
+      secure = session.secure;
+    });
+
+    if (events.empty () ) {
+      return;
+    }
+
+    for (auto it = events.begin (); it != events.end (); it++) {
+      const SessionTable::Message &event = *it;
+      websocketpp::lib::error_code ec;
+      size_t buffered = secure ? getBufferedAmount (&secureServer, hdl) :
+                        getBufferedAmount (&server, hdl);
+
+      /* The client is not reading fast enough: the rest waits in the session
+       * queue, where it counts towards the queue limit */
+      if (maxEventBuffered > 0 && buffered > maxEventBuffered) {
+        bool requeued = false;
+
+        sessions.find (sessionId, [&] (SessionTable::Session & session) {
+          if (SessionTable::isSameConnection (session.connection, hdl) ) {
+            session.events.insert (session.events.begin (), it, events.end () );
+            requeued = true;
+          }
+        });
+
+        if (requeued) {
+          scheduleFlush (sessionId);
+          return;
+        }
+
+        /* Released meanwhile, its queue was discarded */
+        droppedEvents += events.end () - it;
+        break;
+      }
+
+      if (secure) {
+        ec = sendMessage (&secureServer, hdl, *event.payload, event.binary);
+      } else {
+        ec = sendMessage (&server, hdl, *event.payload, event.binary);
+      }
+
+      if (ec) {
+        size_t dropped = events.end () - it;
+
+        GST_ERROR ("Error sending event: %s, %zu events dropped",
+                   ec.message ().c_str (), dropped);
+        droppedEvents += dropped;
+        break;
+      }
+
+      sentEvents++;
+      sentEventBytes += event.payload->size ();
+    }
+  }
+}
+
+/* Flushes again later, the session is still flushing meanwhile */
+void
+WebSocketTransport::scheduleFlush (const std::string &sessionId)
+{
+  std::shared_ptr<boost::asio::steady_timer> timer =
+    std::make_shared<boost::asio::steady_timer> (ios,
+        WEBSOCKET_EVENT_FLUSH_RETRY);
+
+  timer->async_wait ([this, timer, sessionId] (
+  const boost::system::error_code &) {
+    flushEvents (sessionId);
+  });
+}
+
+void
+WebSocketTransport::eventQueueOverflow (const std::string &sessionId,
+                                        websocketpp::connection_hdl hdl, bool secure)
+{
+  if (!closeOnEventQueueOverflow) {
+    droppedEvents++;
+    GST_WARNING ("Event queue full for session %s, dropping event",
+                 sessionId.c_str () );
+    return;
+  }
+
+  GST_WARNING ("Event queue full for session %s, closing connection",
+               sessionId.c_str () );
+  overflowCloses++;
+
+  ios.post ([this, hdl, secure] () {
+    websocketpp::lib::error_code ec;
+
+    if (secure) {
+      secureServer.close (hdl, websocketpp::close::status::policy_violation,
+                          "Event queue overflow", ec);
     } else {
-      lock.unlock();
-      server.send (hdl, message, websocketpp::frame::opcode::TEXT);
+      server.close (hdl, websocketpp::close::status::policy_violation,
+                    "Event queue overflow", ec);
+    }
+  });
+}
+
+void
+WebSocketTransport::getLoadReport (Json::Value &report)
+{
+  size_t queued;
+  size_t maxDepth;
+
+  processor->getLoadReport (report);
+
+  sessions.getQueueDepth (queued, maxDepth);
+
+  report["connections"] =
+      (Json::UInt64) sessions.getConnectedSessions ().size ();
+  report["eventQueue"]["queued"] = (Json::UInt64) queued;
+  report["eventQueue"]["maxSessionDepth"] = (Json::UInt64) maxDepth;
+  report["pendingRequests"] = (Json::Int64) pendingRequests;
+}
+
+void
+WebSocketTransport::getStats (const Json::Value &params, Json::Value &stats)
+{
+  Json::Value queueStats;
+  Json::Value sessionStats;
+  std::string sessionId;
+  size_t queued;
+  size_t maxDepth;
+
+  sessions.getQueueDepth (queued, maxDepth);
+
+  queueStats["queued"] = (Json::UInt64) queued;
+  queueStats["maxSessionDepth"] = (Json::UInt64) maxDepth;
+  queueStats["size"] = (Json::UInt64) maxEventQueue;
+  queueStats["overflowPolicy"] = closeOnEventQueueOverflow ? "close" : "drop";
+  queueStats["sent"] = (Json::UInt64) sentEvents;
+  queueStats["sentBytes"] = (Json::UInt64) sentEventBytes;
+  queueStats["dropped"] = (Json::UInt64) droppedEvents;
+  queueStats["overflowCloses"] = (Json::UInt64) overflowCloses;
+
+  stats["webSocket"]["eventQueue"] = queueStats;
+  stats["webSocket"]["binaryConnections"] = binaryConnections.load ();
+
+  /* Counters of the session of the caller, or the one requested */
+  if (!tryGetValue (params, "sessionId", sessionId) ) {
+    return;
+  }
+
+  bool found = sessions.find (sessionId, [&] (SessionTable::Session & session) {
+    sessionStats["events"] = (Json::UInt64) session.emittedEvents;
+    sessionStats["bytes"] = (Json::UInt64) session.emittedBytes;
+    sessionStats["queued"] = (Json::UInt64) session.events.size ();
+  });
+
+  if (found) {
+    sessionStats["sessionId"] = sessionId;
+    stats["webSocket"]["session"] = sessionStats;
+  }
+}
+
+std::shared_ptr<WebSocketTransport::Strand>
+WebSocketTransport::getSessionStrand (const std::string &sessionId)
+{
+  std::shared_ptr<Strand> strand;
+
+  sessions.modify (sessionId, [&] (SessionTable::Session & session) {
+    strand = session.strand.lock ();
+
+    if (!strand) {
+      strand = std::make_shared<Strand> (rpcIos);
+      session.strand = strand;
     }
-  } catch (std::exception &e) {
-    GST_ERROR ("Error sending event: %s", e.what() );
+  });
+
+  return strand;
+}
+
+std::shared_ptr<WebSocketTransport::Strand>
+WebSocketTransport::acquireStrand (WebSocketConnectionState &state)
+{
+  std::unique_lock<std::mutex> lock (state.mutex);
+  std::string sessionId = state.getSessionId ();
+
+  if (state.isClosed () ) {
+    return nullptr;
+  }
+
+  /* Switching to the session strand keeps the order of requests only when
+   * none of them is still queued in the previous strand */
+  if (state.inFlight == 0 && !sessionId.empty () ) {
+    state.strand = getSessionStrand (sessionId);
   }
+
+  state.inFlight++;
+
+  return state.strand;
+}
+
+void
+WebSocketTransport::releaseStrand (WebSocketConnectionState &state)
+{
+  std::unique_lock<std::mutex> lock (state.mutex);
+
+  state.inFlight--;
 }
 
 template <typename ServerType>
 void WebSocketTransport::processMessage (ServerType *s,
     websocketpp::connection_hdl hdl, typename ServerType::message_ptr msg)
 {
-  std::string request = msg->get_payload();
-  std::string response;
+  websocketpp::lib::error_code ec;
+  std::shared_ptr<WebSocketConnectionState> state = s->get_con_from_hdl (hdl,
+      ec);
+  std::shared_ptr<Strand> strand;
+
+  if (!ec) {
+    strand = acquireStrand (*state);
+  }
+
+  if (!strand) {
+    GST_WARNING ("Message received on a closed connection, ignoring");
+    return;
+  }
+
+  if (pendingRequests >= maxPendingRequests) {
+    releaseStrand (*state);
+    rejectRequest (s, hdl, msg, state);
+    return;
+  }
+
+  pendingRequests++;
+
+  /* Runs on an RPC worker; requests of the same session keep their order,
+   * while different sessions are processed in parallel */
+  strand->post ([this, s, hdl, msg, state] () {
+    pendingRequests--;
+
+    try {
+      processRequest (s, hdl, msg, state);
+    } catch (...) {
+      releaseStrand (*state);
+      throw;
+    }
+
+    releaseStrand (*state);
+  });
+}
+
+template <typename ServerType>
+void WebSocketTransport::rejectRequest (ServerType *s,
+    websocketpp::connection_hdl hdl, typename ServerType::message_ptr msg,
+    std::shared_ptr<WebSocketConnectionState> state)
+{
+  Json::Value request;
+  Json::Value response;
+  Json::Value error;
+  Json::Value data;
+  std::string responseStr;
+  bool binary = (state->getEncoding () == ConnectionState::Encoding::CBOR);
+  bool parsed;
+  KurentoException ex (NOT_ENOUGH_RESOURCES, "Too many pending requests");
+
+  GST_WARNING ("Rejecting request, %d requests pending", maxPendingRequests);
+
+  response[JSON_RPC_PROTO] = JSON_RPC_PROTO_VERSION;
+  response[JSON_RPC_ID] = Json::Value::null;
+
+  if (binary) {
+    parsed = readCbor (msg->get_payload(), request);
+  } else {
+    Json::Reader reader;
+
+    parsed = reader.parse (msg->get_payload(), request);
+  }
+
+  if (parsed && request.isObject () && request.isMember (JSON_RPC_ID) ) {
+    response[JSON_RPC_ID] = request[JSON_RPC_ID];
+  }
+
+  data["type"] = ex.getType ();
+  error["code"] = ex.getCode ();
+  error["message"] = ex.getMessage ();
+  error["data"] = data;
+  response[JSON_RPC_ERROR] = error;
+
+  if (binary) {
+    writeCbor (response, responseStr);
+  } else {
+    writeJson (response, responseStr);
+  }
+
+  websocketpp::lib::error_code ec = sendMessage (s, hdl, responseStr, binary);
+
+  if (ec) {
+    GST_ERROR ("Could not send response to client: %s", ec.message().c_str() );
+  }
+}
+
+/* Bytes written to the connection and not yet taken by the socket */
+template <typename ServerType>
+size_t
+WebSocketTransport::getBufferedAmount (ServerType *s,
+                                       websocketpp::connection_hdl hdl)
+{
+  websocketpp::lib::error_code ec;
+  auto connection = s->get_con_from_hdl (hdl, ec);
+
+  if (ec) {
+    return 0;
+  }
+
+  return connection->get_buffered_amount ();
+}
+
+template <typename ServerType>
+websocketpp::lib::error_code
+WebSocketTransport::sendMessage (ServerType *s, websocketpp::connection_hdl hdl,
+                                 const std::string &payload, bool binary)
+{
+  websocketpp::lib::error_code ec;
+  auto connection = s->get_con_from_hdl (hdl, ec);
+
+  if (ec) {
+    return ec;
+  }
+
+  typename ServerType::message_ptr msg = connection->get_message (
+      binary ? websocketpp::frame::opcode::BINARY :
+      websocketpp::frame::opcode::TEXT, payload.size () );
+
+  msg->append_payload (payload);
+  /* Only applies if permessage-deflate was negotiated */
+  msg->set_compressed (payload.size () >= compressionThreshold);
+
+  return connection->send (msg);
+}
+
+template <typename ServerType>
+void WebSocketTransport::processRequest (ServerType *s,
+    websocketpp::connection_hdl hdl, typename ServerType::message_ptr msg,
+    std::shared_ptr<WebSocketConnectionState> state)
+{
+  /* Reused by every request processed on this thread */
+  static thread_local std::string response;
+  const std::string &request = msg->get_payload();
+  bool binary = (state->getEncoding () == ConnectionState::Encoding::CBOR);
   std::string sessionId;
 
-  try {
-    sessionId = connectionsReverse.at (hdl);
-  } catch (std::out_of_range &e) {
-    /* Ignore, there is no previous sessionId */
+  response.clear ();
+
+  if (!binary) {
+    GST_DEBUG ("Message: %s", request.c_str() );
   }
 
-  GST_DEBUG ("Message: %s", request.c_str() );
-  sessionId = processor->process (request, response, sessionId);
-  GST_DEBUG ("Response: %s", response.c_str() );
+  sessionId = processor->process (request, response, state);
 
-  storeConnection (request, response, hdl,
-                   std::is_same<ServerType, SecureWebSocketServer>::value, sessionId);
+  if (!binary) {
+    GST_DEBUG ("Response: %s", response.c_str() );
+  }
 
-  try {
-    s->send (hdl, response, websocketpp::frame::opcode::TEXT);
-  } catch (websocketpp::exception &e) {
-    GST_ERROR ("Could not send response to client: %s",
-               e.code().message().c_str() );
+  storeConnection (hdl, *state, sessionId);
+
+  websocketpp::lib::error_code ec = sendMessage (s, hdl, response, binary);
+
+  if (ec) {
+    GST_ERROR ("Could not send response to client: %s", ec.message().c_str() );
   }
 }
 
+/* Selects the binary subprotocol if the client requested it, otherwise the
+ * connection is accepted without one and uses JSON text messages */
+template <typename ServerType>
+bool WebSocketTransport::validateHandler (ServerType *s,
+    websocketpp::connection_hdl hdl)
+{
+  auto connection = s->get_con_from_hdl (hdl);
+
+  for (const std::string &protocol : connection->get_requested_subprotocols () ) {
+    if (protocol == WEBSOCKET_CBOR_SUBPROTOCOL) {
+      connection->select_subprotocol (protocol);
+      connection->setEncoding (ConnectionState::Encoding::CBOR);
+      break;
+    }
+  }
+
+  return true;
+}
+
 template <typename ServerType>
 void WebSocketTransport::openHandler (ServerType *s,
                                       websocketpp::connection_hdl hdl)
@@ -576,6 +1136,13 @@ void WebSocketTransport::openHandler (ServerType *s,
   auto connection = s->get_con_from_hdl (hdl);
   std::string resource = connection->get_resource();
 
+  connection->setSecure (std::is_same<ServerType, SecureWebSocketServer>::value);
+  connection->strand = std::make_shared<Strand> (rpcIos);
+
+  if (connection->getEncoding () == ConnectionState::Encoding::CBOR) {
+    binaryConnections++;
+  }
+
   GST_DEBUG ("Client connected from '%s'", connection->get_origin ().c_str ());
 
   if (resource.size() >= 1 && resource[0] == '/') {
@@ -595,50 +1162,107 @@ void WebSocketTransport::openHandler (ServerType *s,
   }
 }
 
+std::shared_ptr<WebSocketEventHandler>
+WebSocketTransport::getEventHandler (std::shared_ptr<MediaObjectImpl> obj,
+                                     const std::string &eventType)
+{
+  std::string eventId = obj->getId() + "|" + eventType;
+  /* Declared before the lock, so that a handler failing to connect is
+   * destroyed, and released, once the lock is freed */
+  std::shared_ptr<WebSocketEventHandler> handler;
+  std::unique_lock<std::mutex> lock (eventHandlersMutex);
+
+  handler = eventHandlers[eventId].lock ();
+
+  if (!handler) {
+    handler = std::make_shared<WebSocketEventHandler> (obj, shared_from_this(),
+              eventId);
+
+    if (!obj->connect (eventType, handler) ) {
+      eventHandlers.erase (eventId);
+      throw KurentoException (MEDIA_OBJECT_EVENT_NOT_SUPPORTED, "Event not found");
+    }
+
+    eventHandlers[eventId] = handler;
+  }
+
+  return handler;
+}
+
+void
+WebSocketTransport::releaseEventHandler (const std::string &eventId)
+{
+  std::unique_lock<std::mutex> lock (eventHandlersMutex);
+  auto it = eventHandlers.find (eventId);
+
+  /* The entry may already belong to a new handler of the same event */
+  if (it != eventHandlers.end () && it->second.expired () ) {
+    eventHandlers.erase (it);
+  }
+}
+
 std::string
 WebSocketTransport::processSubscription (std::shared_ptr< MediaObjectImpl > obj,
     const std::string &sessionId,
     const std::string &eventType,
     const Json::Value &params)
 {
-  std::string subscriptionId;
-  std::string eventId = sessionId + "|" + obj->getId() + "|" + eventType;
-  std::shared_ptr <EventHandler> handler;
-  std::unique_lock<std::recursive_mutex> lock (mutex);
+  std::string subscriptionId = generateUUID();
+  std::string eventId = obj->getId() + "|" + eventType;
+  std::shared_ptr <EventHandler> subscription;
 
-  if (handlers.find (eventId) != handlers.end() ) {
-    handler = handlers[eventId].lock();
-  }
+  sessions.find (sessionId, [&] (SessionTable::Session & session) {
+    auto it = session.handlers.find (eventId);
 
-  if (!handler) {
-    handler = std::shared_ptr <EventHandler> (new WebSocketEventHandler (obj,
-              shared_from_this(), sessionId) );
+    if (it != session.handlers.end() ) {
+      subscription = it->second.lock();
+    }
+  });
 
-    subscriptionId = processor->connectEventHandler (obj, sessionId, eventType,
-                     handler);
-    handlers[eventId] = std::weak_ptr <EventHandler> (handler);
-  } else {
-    subscriptionId = generateUUID();
-    processor->registerEventHandler (obj, sessionId, subscriptionId, handler);
+  /* The processor is called without the session locked, as events may be
+   * sent from it; requests of a session are already serialized */
+  if (!subscription) {
+    std::shared_ptr<WebSocketEventHandler> handler = getEventHandler (obj,
+        eventType);
+
+    subscription = std::make_shared<WebSocketEventSubscription> (obj, handler);
+    handler->addSubscriber (sessionId, subscription);
+
+    sessions.modify (sessionId, [&] (SessionTable::Session & session) {
+      session.handlers[eventId] = std::weak_ptr <EventHandler> (subscription);
+    });
   }
 
+  processor->registerEventHandler (obj, sessionId, subscriptionId,
+                                   subscription);
+
   return subscriptionId;
 }
 
-void WebSocketTransport::closeHandler (websocketpp::connection_hdl hdl)
+template <typename ServerType>
+void WebSocketTransport::closeHandler (ServerType *s,
+                                       websocketpp::connection_hdl hdl)
 {
+  websocketpp::lib::error_code ec;
+  auto connection = s->get_con_from_hdl (hdl, ec);
+
   GST_DEBUG ("Connection closed");
 
-  try {
-    std::unique_lock<std::recursive_mutex> lock (mutex);
-    std::string sessionId = connectionsReverse.at (hdl);
+  if (ec) {
+    return;
+  }
+
+  connection->setClosed ();
+
+  if (connection->getEncoding () == ConnectionState::Encoding::CBOR) {
+    binaryConnections--;
+  }
+
+  std::string sessionId = connection->getSessionId ();
 
+  if (!sessionId.empty () ) {
     GST_DEBUG ("Erasing connection associated with: %s", sessionId.c_str() );
-    connections.erase (sessionId);
-    connectionsReverse.erase (hdl);
-    secureConnections.erase (sessionId);
-  } catch (std::out_of_range &e) {
-    /* Ignore */
+    sessions.release (sessionId, hdl);
   }
 }
 
@@ -20,21 +20,59 @@
 
 #include "Transport.hpp"
 #include "Processor.hpp"
+#include "SessionTable.hpp"
+#include "ConnectionState.hpp"
+#include "DeflateExtension.hpp"
 
 #include <websocketpp/config/asio.hpp>
 #include <websocketpp/server.hpp>
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <mutex>
 #include <condition_variable>
+#include <functional>
 
-typedef websocketpp::server<websocketpp::config::asio> WebSocketServer;
-typedef websocketpp::server<websocketpp::config::asio_tls>
+namespace kurento
+{
+
+/* State attached to every WebSocket connection. Requests received on a
+ * connection are processed in the strand of its session, or in its own one
+ * until it is associated to a session */
+class WebSocketConnectionState : public ConnectionState
+{
+public:
+  std::mutex mutex;
+  std::shared_ptr<boost::asio::io_service::strand> strand;
+  int inFlight = 0;
+};
+
+struct WebSocketDeflateConfig {};
+typedef DeflateExtension<WebSocketDeflateConfig> WebSocketDeflate;
+
+struct WebSocketConfig : public websocketpp::config::asio {
+  typedef WebSocketConfig type;
+  typedef WebSocketConnectionState connection_base;
+  typedef WebSocketDeflate permessage_deflate_type;
+};
+
+struct SecureWebSocketConfig : public websocketpp::config::asio_tls {
+  typedef SecureWebSocketConfig type;
+  typedef WebSocketConnectionState connection_base;
+  typedef WebSocketDeflate permessage_deflate_type;
+};
+
+} /* kurento */
+
+typedef websocketpp::server<kurento::WebSocketConfig> WebSocketServer;
+typedef websocketpp::server<kurento::SecureWebSocketConfig>
 SecureWebSocketServer;
 
 namespace kurento
 {
 
 class WebSocketRegistrar;
+class WebSocketEventHandler;
 
 class WebSocketTransport: public Transport,
   public std::enable_shared_from_this<WebSocketTransport>
@@ -46,7 +84,16 @@ public:
   virtual void start ();
   virtual void stop ();
 
+  typedef std::function<std::shared_ptr<const std::string> () > Encoder;
+
   void send (const std::string &sessionId, const std::string &message);
+  /* The same message can be queued to several sessions without copies.
+   * binaryMessage returns the CBOR encoding, sent instead to sessions
+   * connected with the binary subprotocol. It is only called for those, with
+   * the session locked, so it is known to be connected that way */
+  void send (const std::string &sessionId,
+             std::shared_ptr<const std::string> message,
+             const Encoder &binaryMessage = nullptr);
 
 private:
   // Constructor methods
@@ -54,22 +101,51 @@ private:
   void initSecureWebSocket(const boost::property_tree::ptree &config);
   void initRegistrar (const boost::property_tree::ptree &config);
 
-  websocketpp::connection_hdl getConnection (const std::string &sessionId);
+  void flushEvents (const std::string &sessionId);
+  void scheduleFlush (const std::string &sessionId);
+  void eventQueueOverflow (const std::string &sessionId,
+                           websocketpp::connection_hdl hdl, bool secure);
+  void getStats (const Json::Value &params, Json::Value &stats);
+  void getLoadReport (Json::Value &report);
 
   template <typename ServerType>
   void processMessage (ServerType *s, websocketpp::connection_hdl hdl,
                        typename ServerType::message_ptr msg);
   template <typename ServerType>
+  void processRequest (ServerType *s, websocketpp::connection_hdl hdl,
+                       typename ServerType::message_ptr msg,
+                       std::shared_ptr<WebSocketConnectionState> state);
+  template <typename ServerType>
+  void rejectRequest (ServerType *s, websocketpp::connection_hdl hdl,
+                      typename ServerType::message_ptr msg,
+                      std::shared_ptr<WebSocketConnectionState> state);
+  template <typename ServerType>
+  size_t getBufferedAmount (ServerType *s, websocketpp::connection_hdl hdl);
+  template <typename ServerType>
+  websocketpp::lib::error_code sendMessage (ServerType *s,
+      websocketpp::connection_hdl hdl, const std::string &payload, bool binary);
+
+  typedef boost::asio::io_service::strand Strand;
+
+  std::shared_ptr<Strand> acquireStrand (WebSocketConnectionState &state);
+  void releaseStrand (WebSocketConnectionState &state);
+  std::shared_ptr<Strand> getSessionStrand (const std::string &sessionId);
+  std::shared_ptr<WebSocketConnectionState> getConnectionState (
+    websocketpp::connection_hdl hdl, bool secure);
+  template <typename ServerType>
+  bool validateHandler (ServerType *s, websocketpp::connection_hdl hdl);
+  template <typename ServerType>
   void openHandler (ServerType *s, websocketpp::connection_hdl hdl);
-  void closeHandler (websocketpp::connection_hdl hdl);
-  void run ();
+  template <typename ServerType>
+  void closeHandler (ServerType *s, websocketpp::connection_hdl hdl);
+  void run (boost::asio::io_service &service);
 
   virtual std::string processSubscription (std::shared_ptr<MediaObjectImpl> obj,
       const std::string &sessionId, const std::string &eventType,
       const Json::Value &params);
 
-  void storeConnection (const std::string &request, const std::string &response,
-                        websocketpp::connection_hdl connection, bool secure, std::string &sessionId);
+  void storeConnection (websocketpp::connection_hdl connection,
+                        WebSocketConnectionState &state, const std::string &sessionId);
 
   void keepAliveSessions ();
 
@@ -80,15 +156,54 @@ private:
 
   std::shared_ptr<Processor> processor;
 
-  std::map <std::string, websocketpp::connection_hdl> connections;
-  std::map <std::string, bool> secureConnections;
-  std::map <websocketpp::connection_hdl, std::string,
-      std::owner_less<websocketpp::connection_hdl>> connectionsReverse;
+  SessionTable sessions;
+
+  /* Event handlers shared by all the sessions subscribed to the same event
+   * of an object, keyed by "objectId|eventType" */
+  std::map<std::string, std::weak_ptr<WebSocketEventHandler>> eventHandlers;
+  std::mutex eventHandlersMutex;
+
+  std::shared_ptr<WebSocketEventHandler> getEventHandler (
+    std::shared_ptr<MediaObjectImpl> obj, const std::string &eventType);
+  /* Called by the handler when it is destroyed */
+  void releaseEventHandler (const std::string &eventId);
+
+  friend class WebSocketEventHandler;
+
+  /* Outbound events are queued per session and written by the I/O threads,
+   * so that slow clients do not block the threads raising them. Events stay
+   * in the session queue while the bytes pending on its connection are above
+   * maxEventBuffered, so a client not reading fills its queue */
+  size_t maxEventQueue;
+  size_t maxEventBuffered;
+  bool closeOnEventQueueOverflow;
+  std::atomic<uint64_t> sentEvents{};
+  std::atomic<uint64_t> sentEventBytes{};
+  std::atomic<uint64_t> droppedEvents{};
+  std::atomic<uint64_t> overflowCloses{};
+
+  /* Messages smaller than this are not compressed, even when the client
+   * negotiated permessage-deflate */
+  size_t compressionThreshold;
+
+  /* Open connections that negotiated the CBOR subprotocol */
+  std::atomic<int> binaryConnections{};
+
+  /* Protects the transport lifecycle */
   std::recursive_mutex mutex;
 
   int n_threads;
   std::string path;
   boost::asio::io_service ios;
+
+  /* RPC processing, decoupled from the WebSocket I/O threads. Requests of
+   * each session are serialized through a strand */
+  int n_rpcThreads;
+  int maxPendingRequests;
+  std::atomic<int> pendingRequests{};
+  boost::asio::io_service rpcIos;
+  std::unique_ptr<boost::asio::io_service::work> rpcWork;
+  std::vector<std::thread> rpcThreads;
   WebSocketServer server;
   SecureWebSocketServer secureServer;
   bool hasInsecureServer = false;
@@ -99,8 +214,6 @@ private:
   std::condition_variable_any cond;
   std::shared_ptr <WebSocketRegistrar> registrar;
 
-  std::map <std::string, std::weak_ptr<kurento::EventHandler>> handlers;
-
   class StaticConstructor
   {
   public:
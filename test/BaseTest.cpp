@@ -16,6 +16,7 @@
  */
 
 #include "BaseTest.hpp"
+#include "CborUtils.hpp"
 
 #include "KurentoException.hpp"
 
@@ -50,6 +51,7 @@ static const std::chrono::seconds REPLY_TIMEOUT (10);
 static const int MAX_RETRIES = 20;
 static const std::string WS_PATH = "/kurento";
 static const std::string WS_PROTO = "ws://";
+static const std::string CBOR_SUBPROTOCOL = "kurento.cbor";
 
 void F::create_ws_uri (uint port)
 {
@@ -80,6 +82,10 @@ F::write_config (const boost::filesystem::path &orig, uint port)
   resourceConfig.erase ("exceptionLimit");
   resourceConfig.add ("exceptionLimit", resourceLimit);
 
+  for (auto &value : configValues) {
+    config.put (value.first, value.second);
+  }
+
   boost::property_tree::json_parser::write_json (newConfigFile.string(), config);
 
   return newConfigFile;
@@ -162,18 +168,45 @@ void F::on_open (websocketpp::connection_hdl hdl)
   std::unique_lock <std::mutex> lock (mutex);
   GST_DEBUG ("connection ready");
   connectionHdl = hdl;
+  binary = (client->get_con_from_hdl (hdl)->get_subprotocol () ==
+            CBOR_SUBPROTOCOL);
   initialized = true;
 }
 
+void F::on_close (websocketpp::connection_hdl hdl)
+{
+  std::unique_lock <std::mutex> lock (mutex);
+  GST_DEBUG ("connection closed by the server");
+  closed = true;
+  cond.notify_all();
+}
+
+bool F::waitForClose (const std::chrono::seconds timeout)
+{
+  std::unique_lock <std::mutex> lock (mutex);
+
+  return cond.wait_for (lock, timeout, [this] () {
+    return closed;
+  });
+}
+
 void F::on_message (websocketpp::connection_hdl hdl,
                     WebSocketClient::message_ptr msg)
 {
   std::unique_lock <std::mutex> lock (mutex);
-  GST_DEBUG ("Received a reply: %s", msg->get_payload().c_str() );
-
   Json::Value recvMessage;
-  BOOST_REQUIRE_MESSAGE (reader.parse (msg->get_payload(), recvMessage),
-                         "Cannot parse input message");
+
+  if (msg->get_opcode () == websocketpp::frame::opcode::binary) {
+    BOOST_REQUIRE_MESSAGE (binary, "Binary message on a text connection");
+    BOOST_REQUIRE_MESSAGE (readCbor (msg->get_payload(), recvMessage),
+                           "Cannot parse input message");
+    GST_DEBUG ("Received a binary reply");
+  } else {
+    GST_DEBUG ("Received a reply: %s", msg->get_payload().c_str() );
+    BOOST_REQUIRE_MESSAGE (reader.parse (msg->get_payload(), recvMessage),
+                           "Cannot parse input message");
+  }
+
   recvMessages.push_back (recvMessage);
 
   cond.notify_all();
@@ -207,6 +240,23 @@ Json::Value F::getFirstEvent ()
   throw KurentoException (UNEXPECTED_ERROR, "Resonse not found");
 }
 
+/* Encoded as negotiated by the connection */
+void F::send (const Json::Value &message)
+{
+  if (binary) {
+    std::string payload;
+
+    writeCbor (message, payload);
+    client->send (connectionHdl, payload, websocketpp::frame::opcode::binary);
+    return;
+  }
+
+  Json::StreamWriterBuilder writerFactory;
+  writerFactory["indentation"] = "";
+  client->send (connectionHdl, Json::writeString (writerFactory, message),
+                websocketpp::frame::opcode::text);
+}
+
 Json::Value F::sendRequest (const Json::Value &request)
 {
   std::string response_str, requestId;
@@ -218,10 +268,7 @@ Json::Value F::sendRequest (const Json::Value &request)
 
   sendingMessage = true;
 
-  Json::StreamWriterBuilder writerFactory;
-  writerFactory["indentation"] = "";
-  client->send (connectionHdl, Json::writeString (writerFactory, request),
-                websocketpp::frame::opcode::text);
+  send (request);
 
   requestId = request[JSON_RPC_ID].asString();
 
@@ -237,6 +284,48 @@ Json::Value F::sendRequest (const Json::Value &request)
   return response;
 }
 
+Json::Value F::waitForResponse (const std::string &requestId)
+{
+  std::unique_lock <std::mutex> lock (mutex);
+
+  if (!cond.wait_for (lock, REPLY_TIMEOUT, std::bind (&F::receivedResponse,
+                      this, requestId ) ) ) {
+    BOOST_FAIL ("Timeout waiting for response");
+  }
+
+  return getResponse (requestId);
+}
+
+Json::Value F::sendBatch (const Json::Value &batch)
+{
+  Json::Value response;
+  std::unique_lock <std::mutex> lock (mutex);
+
+  BOOST_REQUIRE_MESSAGE (initialized, "Not initialized");
+  BOOST_REQUIRE_MESSAGE (!sendingMessage, "Already sending a message");
+
+  sendingMessage = true;
+
+  send (batch);
+
+  if (!cond.wait_for (lock, REPLY_TIMEOUT, std::bind (&F::receivedBatchResponse,
+                      this) ) ) {
+    BOOST_FAIL ("Timeout waiting for batch response");
+  }
+
+  sendingMessage = false;
+
+  for (auto it = recvMessages.begin(); it != recvMessages.end(); it++) {
+    if (it->isArray () ) {
+      response = *it;
+      recvMessages.erase (it);
+      break;
+    }
+  }
+
+  return response;
+}
+
 Json::Value F::waifForEvent (const std::chrono::seconds timeout)
 {
   Json::Value event;
@@ -270,6 +359,8 @@ void F::start_client()
                                          std::placeholders::_1) );
     client->set_message_handler (std::bind (&F::on_message, this,
                                             std::placeholders::_1, std::placeholders::_2) );
+    client->set_close_handler (std::bind (&F::on_close, this,
+                                          std::placeholders::_1) );
 
     // Initialize ASIO
     client->init_asio();
@@ -282,6 +373,10 @@ void F::start_client()
       BOOST_ERROR (ec.message() );
     }
 
+    if (cbor) {
+      con->add_subprotocol (CBOR_SUBPROTOCOL);
+    }
+
     client->connect (con);
 
     // Start the ASIO io_service run loop
@@ -357,6 +452,17 @@ bool F::receivedResponse (const std::string &requestId)
   return false;
 }
 
+bool F::receivedBatchResponse ()
+{
+  for (Json::Value message : recvMessages) {
+    if (message.isArray () ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 bool F::receivedEvent ()
 {
   for (Json::Value message : recvMessages) {
@@ -376,6 +482,7 @@ F::start ()
   std::unique_lock <std::mutex> lock (mutex);
 
   id = 0;
+  closed = false;
 
   start_server();
 
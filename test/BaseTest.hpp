@@ -30,6 +30,7 @@
 #include <json/writer.h>
 
 #include <list>
+#include <map>
 
 typedef websocketpp::client<websocketpp::config::asio_client> WebSocketClient;
 
@@ -42,6 +43,8 @@ protected:
   virtual ~F();
 
   Json::Value sendRequest (const Json::Value &request);
+  /* Sends a JSON-RPC batch and returns the array of responses */
+  Json::Value sendBatch (const Json::Value &batch);
   Json::Value waifForEvent (const std::chrono::seconds timeout);
 
   int getId()
@@ -61,6 +64,38 @@ protected:
     resourceLimit = limit;
   }
 
+  /* Requests the CBOR subprotocol when connecting. Messages are encoded in
+   * CBOR if the server accepts it */
+  void setCbor (bool cbor)
+  {
+    this->cbor = cbor;
+  }
+
+  /* Whether the connection negotiated the CBOR subprotocol */
+  bool isBinary () const
+  {
+    return binary;
+  }
+
+  /* Overrides a key of the server configuration, must be set before start */
+  void setConfig (const std::string &key, const std::string &value)
+  {
+    configValues[key] = value;
+  }
+
+  /* Sends a message without waiting for its response */
+  void send (const Json::Value &message);
+  /* Response to a request already sent */
+  Json::Value waitForResponse (const std::string &requestId);
+
+  /* Returns false if the server did not close the connection in time */
+  bool waitForClose (const std::chrono::seconds timeout);
+
+  const std::string &getWsUri () const
+  {
+    return uri;
+  }
+
   void stop();
   void start();
 
@@ -74,9 +109,11 @@ private:
 
   bool initialized = false;
   bool terminate = false;
+  bool closed = false;
   std::mutex mutex;
 
   void on_open (websocketpp::connection_hdl hdl);
+  void on_close (websocketpp::connection_hdl hdl);
   void on_message (websocketpp::connection_hdl hdl,
                    WebSocketClient::message_ptr msg);
 
@@ -100,6 +137,8 @@ private:
 
   bool receivedEvent ();
 
+  bool receivedBatchResponse ();
+
   bool isEvent (const Json::Value &message);
   bool isResponse (const Json::Value &message, const std::string &requestId);
 
@@ -111,6 +150,9 @@ private:
   boost::filesystem::path configDir;
 
   float resourceLimit = 1.0;
+  std::map<std::string, std::string> configValues;
+  bool cbor = false;
+  std::atomic<bool> binary{};
 };
 
 } /* kurento */
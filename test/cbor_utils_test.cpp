@@ -0,0 +1,256 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define BOOST_TEST_MODULE CborUtils
+#include <boost/test/unit_test.hpp>
+
+#include "CborUtils.hpp"
+
+#include <cmath>
+#include <limits>
+
+using namespace kurento;
+
+static std::string
+bytes (std::initializer_list<int> values)
+{
+  std::string data;
+
+  for (int value : values) {
+    data.push_back ( (char) value);
+  }
+
+  return data;
+}
+
+static Json::Value
+roundTrip (const Json::Value &value)
+{
+  std::string data;
+  Json::Value result;
+
+  writeCbor (value, data);
+  BOOST_REQUIRE (readCbor (data, result) );
+
+  return result;
+}
+
+static Json::Value
+read (const std::string &data)
+{
+  Json::Value value;
+
+  BOOST_REQUIRE (readCbor (data, value) );
+
+  return value;
+}
+
+BOOST_AUTO_TEST_CASE ( round_trip )
+{
+  Json::Value value;
+  Json::Value nested;
+
+  value["jsonrpc"] = "2.0";
+  value["id"] = 1;
+  value["method"] = "create";
+  value["params"]["type"] = "MediaPipeline";
+  value["params"]["constructorParams"] = Json::Value (Json::objectValue);
+  value["params"]["properties"]["enabled"] = true;
+  value["params"]["properties"]["disabled"] = false;
+  value["params"]["properties"]["none"] = Json::Value::null;
+  value["params"]["properties"]["ratio"] = 0.1;
+  value["params"]["properties"]["unicode"] = "\xc3\xb1 \xe2\x82\xac";
+  value["params"]["properties"]["empty"] = "";
+  value["params"]["list"] = Json::Value (Json::arrayValue);
+  value["params"]["list"].append (-5);
+  value["params"]["list"].append ("item");
+  nested["inner"] = Json::Value (Json::arrayValue);
+  value["params"]["list"].append (nested);
+  /* Long enough for a header with a 2 bytes length */
+  value["params"]["long"] = std::string (1000, 'x');
+
+  BOOST_CHECK (roundTrip (value) == value);
+}
+
+BOOST_AUTO_TEST_CASE ( integers )
+{
+  const Json::Int64 ints[] = {
+    0, 1, 23, 24, 255, 256, 65535, 65536, 4294967295LL, 4294967296LL,
+    -1, -24, -25, -256, -257, -65537, -4294967297LL,
+    std::numeric_limits<Json::Int64>::max (),
+    std::numeric_limits<Json::Int64>::min ()
+  };
+
+  for (Json::Int64 n : ints) {
+    Json::Value value = roundTrip (Json::Value (n) );
+
+    BOOST_CHECK (value.isInt64 () );
+    BOOST_CHECK_EQUAL (value.asInt64 (), n);
+  }
+
+  Json::Value max = roundTrip (std::numeric_limits<Json::UInt64>::max () );
+
+  BOOST_CHECK (max.isUInt64 () );
+  BOOST_CHECK_EQUAL (max.asUInt64 (), std::numeric_limits<Json::UInt64>::max () );
+
+  /* Shortest headers */
+  std::string data;
+
+  writeCbor (Json::Value (23), data);
+  BOOST_CHECK (data == bytes ({0x17}) );
+  writeCbor (Json::Value (24), data);
+  BOOST_CHECK (data == bytes ({0x18, 0x18}) );
+  writeCbor (Json::Value (-1), data);
+  BOOST_CHECK (data == bytes ({0x20}) );
+  writeCbor (Json::Value (std::numeric_limits<Json::Int64>::min () ), data);
+  BOOST_CHECK (data == bytes ({0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}) );
+
+  /* Negative integers below the range of int64 */
+  Json::Value value;
+
+  BOOST_CHECK (!readCbor (bytes ({0x3b, 0x80, 0, 0, 0, 0, 0, 0, 0}), value) );
+}
+
+BOOST_AUTO_TEST_CASE ( floats )
+{
+  /* Half precision */
+  BOOST_CHECK_EQUAL (read (bytes ({0xf9, 0x3c, 0x00}) ).asDouble (), 1.0);
+  BOOST_CHECK_EQUAL (read (bytes ({0xf9, 0xfb, 0xff}) ).asDouble (), -65504.0);
+  BOOST_CHECK_EQUAL (read (bytes ({0xf9, 0x00, 0x01}) ).asDouble (),
+                     std::ldexp (1.0, -24) );
+  BOOST_CHECK_EQUAL (read (bytes ({0xf9, 0x7c, 0x00}) ).asDouble (),
+                     std::numeric_limits<double>::infinity () );
+  BOOST_CHECK (std::isnan (read (bytes ({0xf9, 0x7e, 0x00}) ).asDouble () ) );
+
+  /* Single precision */
+  BOOST_CHECK_EQUAL (read (bytes ({0xfa, 0x47, 0xc3, 0x50, 0x00}) ).asDouble (),
+                     100000.0);
+
+  /* Double precision */
+  BOOST_CHECK_EQUAL (read (bytes ({0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a}) ).asDouble (),
+                     1.1);
+  BOOST_CHECK_EQUAL (roundTrip (-1.0e300).asDouble (), -1.0e300);
+  BOOST_CHECK_EQUAL (roundTrip (0.1).asDouble (), 0.1);
+}
+
+BOOST_AUTO_TEST_CASE ( simple_values_and_tags )
+{
+  BOOST_CHECK (read (bytes ({0xf4}) ) == Json::Value (false) );
+  BOOST_CHECK (read (bytes ({0xf5}) ) == Json::Value (true) );
+  BOOST_CHECK (read (bytes ({0xf6}) ).isNull () );
+  /* Undefined */
+  BOOST_CHECK (read (bytes ({0xf7}) ).isNull () );
+  /* Tags are ignored */
+  BOOST_CHECK_EQUAL (read (bytes ({0xc1, 0x1a, 0x51, 0x4b, 0x67, 0xb0}) ).asInt64 (),
+                     1363896240);
+  /* Byte strings are read as strings */
+  BOOST_CHECK_EQUAL (read (bytes ({0x42, 'a', 'b'}) ).asString (), "ab");
+}
+
+BOOST_AUTO_TEST_CASE ( indefinite_lengths )
+{
+  Json::Value value;
+
+  value = read (bytes ({0x9f, 0x01, 0x02, 0xff}) );
+  BOOST_REQUIRE (value.isArray () );
+  BOOST_CHECK_EQUAL (value.size (), 2);
+  BOOST_CHECK_EQUAL (value[1].asInt (), 2);
+
+  value = read (bytes ({0xbf, 0x61, 'a', 0x01, 0xff}) );
+  BOOST_REQUIRE (value.isObject () );
+  BOOST_CHECK_EQUAL (value["a"].asInt (), 1);
+
+  BOOST_CHECK_EQUAL (read (bytes ({0x7f, 0x62, 'a', 'b', 0x61, 'c', 0xff}) ).asString (),
+                     "abc");
+  BOOST_CHECK_EQUAL (read (bytes ({0x5f, 0x41, 'a', 0x41, 'b', 0xff}) ).asString (),
+                     "ab");
+
+  /* Chunks must have the type of the string and a definite length */
+  BOOST_CHECK (!readCbor (bytes ({0x7f, 0x41, 'a', 0xff}), value) );
+  BOOST_CHECK (!readCbor (bytes ({0x7f, 0x7f, 0xff, 0xff}), value) );
+  /* Missing break */
+  BOOST_CHECK (!readCbor (bytes ({0x9f, 0x01, 0x02}), value) );
+  /* Integers have no indefinite length */
+  BOOST_CHECK (!readCbor (bytes ({0x1f}), value) );
+}
+
+BOOST_AUTO_TEST_CASE ( truncated_input )
+{
+  Json::Value value;
+  Json::Value result;
+  std::string data;
+
+  value["method"] = "invoke";
+  value["params"]["operationParams"]["values"].append (1.5);
+  value["params"]["operationParams"]["values"].append (
+    std::numeric_limits<Json::Int64>::max () );
+  value["params"]["operationParams"]["values"].append ("text");
+
+  writeCbor (value, data);
+
+  for (size_t size = 0; size < data.size (); size++) {
+    BOOST_CHECK_MESSAGE (!readCbor (data.substr (0, size), result),
+                         "Read truncated to " << size << " bytes");
+  }
+
+  /* Trailing data */
+  BOOST_CHECK (!readCbor (data + bytes ({0x00}), result) );
+  BOOST_CHECK (readCbor (data, result) );
+}
+
+BOOST_AUTO_TEST_CASE ( depth_limit )
+{
+  const int MAX_DEPTH = 1000;
+  Json::Value value;
+
+  std::string nested = std::string (MAX_DEPTH, (char) 0x81) + bytes ({0x00});
+  std::string tooNested = std::string (MAX_DEPTH + 1, (char) 0x81) +
+                          bytes ({0x00});
+
+  BOOST_CHECK (readCbor (nested, value) );
+  BOOST_CHECK (!readCbor (tooNested, value) );
+}
+
+BOOST_AUTO_TEST_CASE ( map_keys )
+{
+  Json::Value value;
+
+  /* Integer and byte string keys can not be represented in JSON */
+  BOOST_CHECK (!readCbor (bytes ({0xa1, 0x01, 0x02}), value) );
+  BOOST_CHECK (!readCbor (bytes ({0xa1, 0x41, 'a', 0x01}), value) );
+  BOOST_CHECK (!readCbor (bytes ({0xa1, 0xf6, 0x01}), value) );
+
+  BOOST_CHECK (readCbor (bytes ({0xa1, 0x61, 'a', 0x01}), value) );
+}
+
+BOOST_AUTO_TEST_CASE ( array_header )
+{
+  std::string data;
+  std::string item;
+  Json::Value value;
+
+  appendCborArrayHeader (2, data);
+  writeCbor ("first", item);
+  data += item;
+  writeCbor (2, item);
+  data += item;
+
+  BOOST_REQUIRE (readCbor (data, value) );
+  BOOST_REQUIRE (value.isArray () );
+  BOOST_CHECK_EQUAL (value[0].asString (), "first");
+  BOOST_CHECK_EQUAL (value[1].asInt (), 2);
+}
@@ -23,11 +23,14 @@
 
 #include <websocketpp/config/asio.hpp>
 #include <websocketpp/server.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include <WebSocketRegistrar.hpp>
 #include <boost/filesystem.hpp>
 
 #include <gst/gst.h>
+#include <json/json.h>
+#include <sstream>
 #include <string>
 
 static const int PORT = 9898;
@@ -52,6 +55,28 @@ SecureWebSocketServer;
 
 typedef websocketpp::lib::shared_ptr<boost::asio::ssl::context> context_ptr;
 
+static const std::chrono::seconds TIMEOUT (10);
+
+/* Runs ios until it is stopped, failing if that takes more than TIMEOUT */
+static void
+runWithDeadline (boost::asio::io_service &ios)
+{
+  boost::asio::steady_timer deadline (ios, TIMEOUT);
+  bool expired = false;
+
+  deadline.async_wait ([&ios, &expired] (const boost::system::error_code &
+  ec) {
+    if (!ec) {
+      expired = true;
+      ios.stop();
+    }
+  });
+
+  ios.run();
+
+  BOOST_CHECK_MESSAGE (!expired, "Registrar message not received in time");
+}
+
 BOOST_AUTO_TEST_CASE ( ws_registrar )
 {
   WebSocketServer server;
@@ -79,13 +104,66 @@ BOOST_AUTO_TEST_CASE ( ws_registrar )
 
   server.start_accept();
 
-  // TODO: Add timeout to not block forever
-  ios.run();
+  runWithDeadline (ios);
 
   registrar.stop();
   server.stop_listening();
 }
 
+BOOST_AUTO_TEST_CASE ( ws_registrar_load_report )
+{
+  WebSocketServer server;
+  boost::asio::io_service ios;
+  int messages = 0;
+
+  kurento::WebSocketRegistrar registrar ("ws://localhost:" + std::to_string (
+      PORT), LOCAL_ADDRESS, LOCAL_PORT, 0, WS_PATH);
+
+  registrar.setLoadReport (std::chrono::milliseconds (50),
+  [] (Json::Value & report) {
+    report["sessions"] = 3;
+  });
+
+  registrar.start();
+
+  // Create websocket
+  server.clear_access_channels (websocketpp::log::alevel::all);
+  server.clear_error_channels (websocketpp::log::alevel::all);
+
+  server.init_asio (&ios);
+  server.set_reuse_addr (true);
+  server.set_message_handler ( [&ios, &messages] (websocketpp::connection_hdl
+  hdl, typename WebSocketServer::message_ptr msg) {
+    Json::Value notification;
+    Json::CharReaderBuilder readerFactory;
+    std::istringstream stream (msg->get_payload () );
+    std::string errs;
+
+    if (messages++ == 0) {
+      BOOST_CHECK_EQUAL (msg->get_payload(), REGISTRAR_MESSAGE);
+      return;
+    }
+
+    BOOST_REQUIRE (Json::parseFromStream (readerFactory, stream, &notification,
+                                          &errs) );
+    BOOST_CHECK (!notification.isMember ("id") );
+    BOOST_CHECK_EQUAL (notification["method"].asString (), "loadReport");
+    BOOST_CHECK_EQUAL (notification["params"]["sessions"].asInt (), 3);
+    ios.stop();
+  });
+
+  server.listen (PORT);
+
+  server.start_accept();
+
+  runWithDeadline (ios);
+
+  registrar.stop();
+  server.stop_listening();
+
+  BOOST_CHECK_EQUAL (messages, 2);
+}
+
 BOOST_AUTO_TEST_CASE ( wss_registrar )
 {
   SecureWebSocketServer server;
@@ -134,8 +212,7 @@ BOOST_AUTO_TEST_CASE ( wss_registrar )
 
   server.start_accept();
 
-  // TODO: Add timeout to not block forever
-  ios.run();
+  runWithDeadline (ios);
 
   registrar.stop();
   server.stop_listening();
@@ -0,0 +1,184 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define BOOST_TEST_MODULE ResourceManager
+#include <boost/test/unit_test.hpp>
+
+#include <ResourceManager.hpp>
+#include <KurentoException.hpp>
+
+#include <gst/gst.h>
+#include <boost/filesystem.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <vector>
+#include <fstream>
+#include <string>
+
+using namespace kurento;
+
+struct GstFixture {
+  GstFixture ()
+  {
+    gst_init (nullptr, nullptr);
+  }
+};
+
+BOOST_GLOBAL_FIXTURE (GstFixture);
+
+/* Without the sampler, usage is measured on every check, even when the
+ * extra usage alone looks below the limit */
+BOOST_AUTO_TEST_CASE ( check_without_sampler )
+{
+  const int OPEN_FILES = 200;
+  struct rlimit original;
+  struct rlimit limits;
+  std::vector<int> fds;
+
+  BOOST_REQUIRE (getResourceSampleCount () == 0);
+
+  for (int i = 0; i < OPEN_FILES; i++) {
+    int fd = open ("/dev/null", O_RDONLY);
+
+    BOOST_REQUIRE (fd >= 0);
+    fds.push_back (fd);
+  }
+
+  getrlimit (RLIMIT_NOFILE, &original);
+  limits = original;
+  limits.rlim_cur = 2 * OPEN_FILES;
+  BOOST_REQUIRE (limits.rlim_max == RLIM_INFINITY
+                 || limits.rlim_max >= limits.rlim_cur);
+  BOOST_REQUIRE (setrlimit (RLIMIT_NOFILE, &limits) == 0);
+
+  BOOST_REQUIRE_EQUAL (getMaxOpenFiles (), limits.rlim_cur);
+
+  BOOST_CHECK_NO_THROW (checkResources (1.0, {0, 0, 0}) );
+  /* Below the limit by itself, above it with the files already open */
+  BOOST_CHECK_THROW (checkResources (1.0, {0, OPEN_FILES + 50, 0}),
+                     KurentoException);
+
+  for (int fd : fds) {
+    close (fd);
+  }
+
+  setrlimit (RLIMIT_NOFILE, &original);
+}
+
+/* Fake root with a /proc/self/cgroup and a cgroup v2 hierarchy, used as the
+ * cgroup root while the test runs */
+struct CgroupFixture {
+  CgroupFixture ()
+  {
+    root = boost::filesystem::unique_path (
+             boost::filesystem::temp_directory_path() / "kms_cgroup_%%%%%%%%" );
+    boost::filesystem::create_directories (root / "proc/self");
+    boost::filesystem::create_directories (root / "sys/fs/cgroup/kms/inner");
+
+    setCgroupRoot (root.string () );
+
+    struct rlimit limits;
+
+    getrlimit (RLIMIT_NPROC, &limits);
+    systemThreads = limits.rlim_cur;
+    systemMemory = (rlim_t) sysconf (_SC_PHYS_PAGES) * sysconf (_SC_PAGESIZE);
+    systemCpus = std::max (sysconf (_SC_NPROCESSORS_ONLN), 1L);
+  }
+
+  ~CgroupFixture ()
+  {
+    setCgroupRoot ("");
+    boost::filesystem::remove_all (root);
+  }
+
+  void write (const std::string &path, const std::string &content)
+  {
+    std::ofstream file ( (root / path).string () );
+
+    file << content << std::endl;
+    /* Limits are cached, so they are read again with the new files */
+    setCgroupRoot (root.string () );
+  }
+
+  void writeLimits (const std::string &cgroup, const std::string &pids,
+                    const std::string &memory, const std::string &cpu)
+  {
+    write ("sys/fs/cgroup/" + cgroup + "/pids.max", pids);
+    write ("sys/fs/cgroup/" + cgroup + "/memory.max", memory);
+    write ("sys/fs/cgroup/" + cgroup + "/cpu.max", cpu);
+  }
+
+  boost::filesystem::path root;
+  rlim_t systemThreads;
+  rlim_t systemMemory;
+  double systemCpus;
+};
+
+BOOST_FIXTURE_TEST_SUITE ( cgroup_limits, CgroupFixture )
+
+BOOST_AUTO_TEST_CASE ( cgroup_max )
+{
+  write ("proc/self/cgroup", "0::/kms/inner");
+  writeLimits ("kms", "max", "max", "max 100000");
+  writeLimits ("kms/inner", "max", "max", "max 100000");
+
+  BOOST_CHECK_EQUAL (getMaxThreads (), systemThreads);
+  BOOST_CHECK_EQUAL (getMaxMemory (), systemMemory);
+  BOOST_CHECK_EQUAL (getCpuLimit (), systemCpus);
+}
+
+BOOST_AUTO_TEST_CASE ( cgroup_values )
+{
+  write ("proc/self/cgroup", "0::/kms/inner/");
+  writeLimits ("kms", "max", "max", "max 100000");
+  writeLimits ("kms/inner", "10", "1048576", "50000 100000");
+
+  BOOST_CHECK_EQUAL (getMaxThreads (), std::min<rlim_t> (systemThreads, 10) );
+  BOOST_CHECK_EQUAL (getMaxMemory (), std::min<rlim_t> (systemMemory,
+                     1048576) );
+  BOOST_CHECK_EQUAL (getCpuLimit (), std::min (systemCpus, 0.5) );
+}
+
+/* Every ancestor limits its descendants */
+BOOST_AUTO_TEST_CASE ( cgroup_stricter_ancestor )
+{
+  write ("proc/self/cgroup", "0::/kms/inner");
+  writeLimits ("kms", "5", "524288", "25000 100000");
+  writeLimits ("kms/inner", "10", "1048576", "50000 100000");
+
+  BOOST_CHECK_EQUAL (getMaxThreads (), std::min<rlim_t> (systemThreads, 5) );
+  BOOST_CHECK_EQUAL (getMaxMemory (), std::min<rlim_t> (systemMemory,
+                     524288) );
+  BOOST_CHECK_EQUAL (getCpuLimit (), std::min (systemCpus, 0.25) );
+}
+
+/* Only cgroup v1 hierarchies: the cgroup v2 files are not read */
+BOOST_AUTO_TEST_CASE ( cgroup_v1_only )
+{
+  write ("proc/self/cgroup", "1:name=systemd:/kms/inner\n2:cpu,cpuacct:/kms");
+  writeLimits ("kms", "5", "524288", "25000 100000");
+  writeLimits ("kms/inner", "10", "1048576", "50000 100000");
+
+  BOOST_CHECK_EQUAL (getMaxThreads (), systemThreads);
+  BOOST_CHECK_EQUAL (getMaxMemory (), systemMemory);
+  BOOST_CHECK_EQUAL (getCpuLimit (), systemCpus);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,818 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * RPC throughput measurements. Results are reported as test messages (run
+ * with --log_level=message); compare them between builds to evaluate changes
+ * in the request processing path.
+ */
+
+#include "BaseTest.hpp"
+#include "JsonUtils.hpp"
+#include "CborUtils.hpp"
+#include <boost/test/unit_test.hpp>
+
+#include <gst/gst.h>
+
+#include <json/json.h>
+
+#include <zlib.h>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#define GST_CAT_DEFAULT _server_benchmark_
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "test_server_benchmark"
+
+#define ITERATIONS 5000
+#define LOAD_ITERATIONS 2000
+#define LOAD_TIMEOUT std::chrono::seconds (10)
+#define SERIALIZATIONS 1000
+#define COMPRESSIONS 1000
+#define CREATES 500
+#define CREATE_OPEN_FILES 50000
+
+#define CBOR_SUBPROTOCOL "kurento.cbor"
+
+/* Heap allocations done by this process, to measure serialization costs */
+static std::atomic<uint64_t> allocations{};
+
+void *
+operator new (std::size_t size)
+{
+  void *ptr;
+
+  allocations++;
+  ptr = std::malloc (size == 0 ? 1 : size);
+
+  if (ptr == nullptr) {
+    throw std::bad_alloc ();
+  }
+
+  return ptr;
+}
+
+void
+operator delete (void *ptr) noexcept
+{
+  std::free (ptr);
+}
+
+namespace kurento
+{
+
+/*
+ * Independent connection used to generate load from several threads. Worker
+ * threads must not use Boost.Test assertions, so failures are reported
+ * through the return values and checked by the test thread.
+ */
+class LoadClient
+{
+public:
+  /* With cbor, the CBOR subprotocol is requested and used if accepted */
+  LoadClient (const std::string &uri, bool cbor = false);
+  ~LoadClient ();
+
+  bool isConnected ();
+  bool isBinary ();
+  bool sendRequest (Json::Value &request, Json::Value &response);
+
+private:
+  void onOpen (websocketpp::connection_hdl hdl);
+  void onMessage (websocketpp::connection_hdl hdl,
+                  WebSocketClient::message_ptr msg);
+
+  WebSocketClient client;
+  websocketpp::connection_hdl connectionHdl;
+  std::thread thread;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool connected = false;
+  bool binary = false;
+  bool received = false;
+  std::string payload;
+  int id = 0;
+};
+
+LoadClient::LoadClient (const std::string &uri, bool cbor)
+{
+  websocketpp::lib::error_code ec;
+
+  client.clear_access_channels (websocketpp::log::alevel::all);
+  client.clear_error_channels (websocketpp::log::elevel::all);
+
+  client.set_open_handler (std::bind (&LoadClient::onOpen, this,
+                                      std::placeholders::_1) );
+  client.set_message_handler (std::bind (&LoadClient::onMessage, this,
+                                         std::placeholders::_1, std::placeholders::_2) );
+
+  client.init_asio ();
+
+  WebSocketClient::connection_ptr con = client.get_connection (uri, ec);
+
+  if (!ec) {
+    if (cbor) {
+      con->add_subprotocol (CBOR_SUBPROTOCOL);
+    }
+
+    client.connect (con);
+  }
+
+  thread = std::thread ([this] () {
+    client.run ();
+  });
+}
+
+LoadClient::~LoadClient ()
+{
+  websocketpp::lib::error_code ec;
+
+  if (isConnected () ) {
+    client.close (connectionHdl, websocketpp::close::status::normal, "", ec);
+  }
+
+  client.stop ();
+  thread.join ();
+}
+
+void
+LoadClient::onOpen (websocketpp::connection_hdl hdl)
+{
+  std::unique_lock <std::mutex> lock (mutex);
+
+  connectionHdl = hdl;
+  connected = true;
+  binary = (client.get_con_from_hdl (hdl)->get_subprotocol () ==
+            CBOR_SUBPROTOCOL);
+  cond.notify_all ();
+}
+
+void
+LoadClient::onMessage (websocketpp::connection_hdl hdl,
+                       WebSocketClient::message_ptr msg)
+{
+  std::unique_lock <std::mutex> lock (mutex);
+
+  payload = msg->get_payload ();
+  received = true;
+  cond.notify_all ();
+}
+
+bool
+LoadClient::isConnected ()
+{
+  std::unique_lock <std::mutex> lock (mutex);
+
+  return cond.wait_for (lock, LOAD_TIMEOUT, [this] () {
+    return connected;
+  });
+}
+
+bool
+LoadClient::isBinary ()
+{
+  std::unique_lock <std::mutex> lock (mutex);
+
+  return binary;
+}
+
+bool
+LoadClient::sendRequest (Json::Value &request, Json::Value &response)
+{
+  Json::Reader reader;
+  websocketpp::lib::error_code ec;
+  std::string requestStr;
+  std::unique_lock <std::mutex> lock (mutex);
+
+  request["id"] = id++;
+  received = false;
+
+  if (binary) {
+    writeCbor (request, requestStr);
+    client.send (connectionHdl, requestStr, websocketpp::frame::opcode::binary,
+                 ec);
+  } else {
+    writeJson (request, requestStr);
+    client.send (connectionHdl, requestStr, websocketpp::frame::opcode::text, ec);
+  }
+
+  if (ec) {
+    return false;
+  }
+
+  if (!cond.wait_for (lock, LOAD_TIMEOUT, [this] () {
+  return received;
+} ) ) {
+    return false;
+  }
+
+  if (binary) {
+    return readCbor (payload, response) && !response.isMember ("error");
+  }
+
+  return reader.parse (payload, response) && !response.isMember ("error");
+}
+
+class ClientHandler : public F
+{
+public:
+  ClientHandler() : F()
+  {
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+                             GST_DEFAULT_NAME);
+  };
+
+  ~ClientHandler() override = default;
+
+protected:
+  std::string createPipeline (const std::string &sessionId);
+  void measure (const std::string &name, Json::Value request);
+  double measureSessions (unsigned sessions);
+  double measureEncoding (bool binary, const std::string &method);
+  void measureCreate (const std::string &name);
+};
+
+std::string
+ClientHandler::createPipeline (const std::string &sessionId)
+{
+  Json::Value request;
+  Json::Value response;
+  Json::Value params;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "create";
+  params["type"] = "MediaPipeline";
+  params["sessionId"] = sessionId;
+  request["params"] = params;
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (!response.isMember ("error") );
+
+  return response["result"]["value"].asString();
+}
+
+void
+ClientHandler::measure (const std::string &name, Json::Value request)
+{
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+  Json::Value response;
+
+  start = std::chrono::steady_clock::now ();
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    request["id"] = getId();
+    response = sendRequest (request);
+
+    BOOST_REQUIRE (!response.isMember ("error") );
+  }
+
+  elapsed = std::chrono::steady_clock::now () - start;
+
+  BOOST_TEST_MESSAGE (name << ": " << ITERATIONS / elapsed.count ()
+                      << " requests/s, " << elapsed.count () * 1e6 / ITERATIONS
+                      << " us/request");
+}
+
+/*
+ * Runs LOAD_ITERATIONS invocations on each of the given number of sessions
+ * concurrently, one connection and pipeline per session, and returns the
+ * aggregated throughput in requests per second.
+ */
+double
+ClientHandler::measureSessions (unsigned sessions)
+{
+  std::vector<std::shared_ptr<LoadClient>> clients;
+  std::vector<std::thread> threads;
+  std::atomic<int> failures{};
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+
+  for (unsigned i = 0; i < sessions; i++) {
+    clients.push_back (std::make_shared<LoadClient> (getWsUri () ) );
+    BOOST_REQUIRE (clients.back ()->isConnected () );
+  }
+
+  start = std::chrono::steady_clock::now ();
+
+  for (unsigned i = 0; i < sessions; i++) {
+    threads.emplace_back ([i, &clients, &failures] () {
+      std::shared_ptr<LoadClient> client = clients[i];
+      std::string sessionId = "load-" + std::to_string (i);
+      Json::Value request;
+      Json::Value response;
+      Json::Value params;
+      Json::Value pipeId;
+
+      request["jsonrpc"] = "2.0";
+      request["method"] = "create";
+      params["type"] = "MediaPipeline";
+      params["sessionId"] = sessionId;
+      request["params"] = params;
+
+      if (!client->sendRequest (request, response) ) {
+        failures++;
+        return;
+      }
+
+      pipeId = response["result"]["value"];
+
+      request["method"] = "invoke";
+      params.clear ();
+      params["object"] = pipeId;
+      params["operation"] = "getName";
+      params["sessionId"] = sessionId;
+      request["params"] = params;
+
+      for (int j = 0; j < LOAD_ITERATIONS; j++) {
+        if (!client->sendRequest (request, response) ) {
+          failures++;
+          return;
+        }
+      }
+
+      request["method"] = "release";
+      params.clear ();
+      params["object"] = pipeId;
+      params["sessionId"] = sessionId;
+      request["params"] = params;
+
+      client->sendRequest (request, response);
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join ();
+  }
+
+  elapsed = std::chrono::steady_clock::now () - start;
+
+  BOOST_REQUIRE_EQUAL (failures.load (), 0);
+
+  return sessions * LOAD_ITERATIONS / elapsed.count ();
+}
+
+/*
+ * Runs LOAD_ITERATIONS requests of the given method on a pipeline through a
+ * connection using JSON or the CBOR subprotocol, and returns the throughput
+ * in requests per second.
+ */
+double
+ClientHandler::measureEncoding (bool binary, const std::string &method)
+{
+  LoadClient client (getWsUri (), binary);
+  std::string sessionId = binary ? "cbor" : "json";
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+  Json::Value request;
+  Json::Value response;
+  Json::Value params;
+  Json::Value pipeId;
+
+  BOOST_REQUIRE (client.isConnected () );
+  BOOST_REQUIRE_EQUAL (client.isBinary (), binary);
+
+  request["jsonrpc"] = "2.0";
+  request["method"] = "create";
+  params["type"] = "MediaPipeline";
+  params["sessionId"] = sessionId;
+  request["params"] = params;
+
+  BOOST_REQUIRE (client.sendRequest (request, response) );
+
+  pipeId = response["result"]["value"];
+  BOOST_REQUIRE (pipeId.isString () );
+
+  request["method"] = method;
+  params.clear ();
+  params["object"] = pipeId;
+  params["sessionId"] = sessionId;
+
+  if (method == "invoke") {
+    params["operation"] = "getName";
+  }
+
+  request["params"] = params;
+
+  start = std::chrono::steady_clock::now ();
+
+  for (int i = 0; i < LOAD_ITERATIONS; i++) {
+    BOOST_REQUIRE (client.sendRequest (request, response) );
+  }
+
+  elapsed = std::chrono::steady_clock::now () - start;
+
+  request["method"] = "release";
+  params.clear ();
+  params["object"] = pipeId;
+  params["sessionId"] = sessionId;
+  request["params"] = params;
+
+  client.sendRequest (request, response);
+
+  return LOAD_ITERATIONS / elapsed.count ();
+}
+
+/*
+ * Latency of creating a pipeline, which includes the resource limits check,
+ * releasing it after each measurement.
+ */
+void
+ClientHandler::measureCreate (const std::string &name)
+{
+  std::vector<double> latencies;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+  double total = 0;
+  Json::Value request;
+  Json::Value response;
+  Json::Value params;
+
+  for (int i = 0; i < CREATES; i++) {
+    request["jsonrpc"] = "2.0";
+    request["id"] = getId();
+    request["method"] = "create";
+    params.clear ();
+    params["type"] = "MediaPipeline";
+    params["sessionId"] = "create-latency";
+    request["params"] = params;
+
+    start = std::chrono::steady_clock::now ();
+    response = sendRequest (request);
+    elapsed = std::chrono::steady_clock::now () - start;
+
+    BOOST_REQUIRE (!response.isMember ("error") );
+
+    latencies.push_back (elapsed.count () * 1e6);
+    total += latencies.back ();
+
+    request["id"] = getId();
+    request["method"] = "release";
+    params.clear ();
+    params["object"] = response["result"]["value"];
+    params["sessionId"] = "create-latency";
+    request["params"] = params;
+
+    sendRequest (request);
+  }
+
+  std::sort (latencies.begin (), latencies.end () );
+
+  BOOST_TEST_MESSAGE (name << ": create " << total / CREATES << " us mean, "
+                      << latencies[CREATES / 2] << " us p50, "
+                      << latencies[CREATES * 99 / 100] << " us p99");
+}
+
+/*
+ * Opens up to count descriptors, raising the soft limit if needed. They are
+ * inherited by the server started afterwards.
+ */
+static std::vector<int>
+openFiles (size_t count)
+{
+  std::vector<int> fds;
+  struct rlimit limits;
+
+  getrlimit (RLIMIT_NOFILE, &limits);
+  limits.rlim_cur = limits.rlim_max;
+  setrlimit (RLIMIT_NOFILE, &limits);
+
+  /* Keep the server far from its resource limits */
+  count = std::min<size_t> (count, limits.rlim_cur / 2);
+
+  for (size_t i = 0; i < count; i++) {
+    int fd = open ("/dev/null", O_RDONLY);
+
+    if (fd < 0) {
+      break;
+    }
+
+    fds.push_back (fd);
+  }
+
+  return fds;
+}
+
+/*
+ * Allocations per serialization with a new writer and output string for each
+ * message, as done before, and with the thread local writer and a reused
+ * output string.
+ */
+static void
+measureAllocations (const std::string &name, const Json::Value &value)
+{
+  std::string out;
+  uint64_t before;
+  uint64_t after;
+  uint64_t start;
+
+  start = allocations;
+
+  for (int i = 0; i < SERIALIZATIONS; i++) {
+    Json::StreamWriterBuilder writerFactory;
+    writerFactory["indentation"] = "";
+    std::string str = Json::writeString (writerFactory, value);
+  }
+
+  before = allocations - start;
+
+  /* Warm up the writer and the output buffer */
+  kurento::writeJson (value, out);
+
+  start = allocations;
+
+  for (int i = 0; i < SERIALIZATIONS; i++) {
+    kurento::writeJson (value, out);
+  }
+
+  after = allocations - start;
+
+  BOOST_TEST_MESSAGE (name << ": " << (double) before / SERIALIZATIONS
+                      << " allocations before, " << (double) after / SERIALIZATIONS
+                      << " allocations after");
+
+  BOOST_CHECK (after < before);
+}
+
+/*
+ * Compression ratio and CPU time of permessage-deflate for a message, with
+ * the settings used by the server: raw deflate, 15 bits window and context
+ * takeover, so every message is compressed on the same stream.
+ */
+static void
+measureCompression (const std::string &name, const std::string &message,
+                    int level)
+{
+  std::chrono::steady_clock::time_point start;
+  std::chrono::duration<double> elapsed;
+  std::vector<unsigned char> buffer (message.size () + 1024);
+  size_t compressed = 0;
+  z_stream stream = {};
+
+  BOOST_REQUIRE (deflateInit2 (&stream, level, Z_DEFLATED, -15, 8,
+                               Z_DEFAULT_STRATEGY) == Z_OK);
+
+  start = std::chrono::steady_clock::now ();
+
+  for (int i = 0; i < COMPRESSIONS; i++) {
+    stream.next_in = (unsigned char *) const_cast<char *> (message.data () );
+    stream.avail_in = message.size ();
+    stream.next_out = buffer.data ();
+    stream.avail_out = buffer.size ();
+
+    BOOST_REQUIRE (deflate (&stream, Z_SYNC_FLUSH) == Z_OK);
+    /* The 4 bytes of the sync flush marker are not sent */
+    compressed += buffer.size () - stream.avail_out - 4;
+  }
+
+  elapsed = std::chrono::steady_clock::now () - start;
+
+  deflateEnd (&stream);
+
+  BOOST_TEST_MESSAGE (name << " (" << message.size () << " bytes), level "
+                      << level << ": ratio " << (double) message.size () * COMPRESSIONS /
+                      compressed << ", " << elapsed.count () * 1e6 / COMPRESSIONS
+                      << " us/message");
+}
+
+BOOST_FIXTURE_TEST_SUITE ( server_benchmark, ClientHandler)
+
+BOOST_AUTO_TEST_CASE ( rpc_throughput )
+{
+  Json::Value request;
+  Json::Value params;
+  std::string sessionId = "benchmark";
+  std::string pipeId;
+
+  start ();
+
+  pipeId = createPipeline (sessionId);
+
+  request["jsonrpc"] = "2.0";
+  request["method"] = "ping";
+  params["interval"] = 240000;
+  request["params"] = params;
+
+  measure ("ping", request);
+
+  request["method"] = "describe";
+  params.clear ();
+  params["object"] = pipeId;
+  params["sessionId"] = sessionId;
+  request["params"] = params;
+
+  measure ("describe", request);
+
+  /* No operationParams, the optional parameters path */
+  request["method"] = "invoke";
+  params.clear ();
+  params["object"] = pipeId;
+  params["operation"] = "getName";
+  params["sessionId"] = sessionId;
+  request["params"] = params;
+
+  measure ("invoke", request);
+}
+
+BOOST_AUTO_TEST_CASE ( serialization_allocations )
+{
+  Json::Value response;
+  Json::Value result;
+  Json::Value event;
+  Json::Value params;
+  Json::Value value;
+  Json::Value data;
+
+  result["value"] = "MediaPipeline-c6a5a3f8-5b1c-4ca3-b0e6-1e0d1c3f3a17";
+  result["sessionId"] = "2e7ab6d6-4a1f-4d4f-a8a1-4a1b9ad55a8f";
+  response["jsonrpc"] = "2.0";
+  response["id"] = 42;
+  response["result"] = result;
+
+  measureAllocations ("response", response);
+
+  data["candidate"] =
+    "candidate:1 1 UDP 2013266431 192.168.1.10 45678 typ host";
+  data["sdpMid"] = "0";
+  data["sdpMLineIndex"] = 0;
+  value["data"] = data;
+  value["object"] = "WebRtcEndpoint-0b9d4c8e-7a3f-4c5b-9d1e-2f6a8b4c7d3e";
+  value["type"] = "IceCandidateFound";
+  params["value"] = value;
+  event["jsonrpc"] = "2.0";
+  event["method"] = "onEvent";
+  event["params"] = params;
+
+  measureAllocations ("event", event);
+}
+
+BOOST_AUTO_TEST_CASE ( compression )
+{
+  Json::Value stats;
+  Json::Value describe;
+  std::string statsStr;
+  std::string describeStr;
+
+  /* getStats result of an endpoint with several streams */
+  for (int i = 0; i < 40; i++) {
+    Json::Value stat;
+    std::string id = "RTCInboundRTPStreamStats_" + std::to_string (i);
+
+    stat["id"] = id;
+    stat["type"] = "inboundrtp";
+    stat["timestamp"] = 1539000000.0 + i;
+    stat["ssrc"] = std::to_string (2500000000u + i);
+    stat["packetsReceived"] = 120000 + i * 37;
+    stat["bytesReceived"] = (Json::UInt64) (150000000u + i * 4099);
+    stat["packetsLost"] = i % 7;
+    stat["jitter"] = 0.0012 * i;
+    stat["fractionLost"] = 0;
+    stat["remb"] = 1500000 + i * 1000;
+    stat["firCount"] = i % 3;
+    stat["pliCount"] = i % 5;
+    stat["nackCount"] = i * 2;
+    stats["result"]["value"][id] = stat;
+  }
+
+  stats["jsonrpc"] = "2.0";
+  stats["id"] = 1;
+
+  /* transaction / describe style response */
+  for (int i = 0; i < 100; i++) {
+    Json::Value object;
+
+    object["type"] = "WebRtcEndpoint";
+    object["qualifiedType"] = "kurento.WebRtcEndpoint";
+    object["hierarchy"].append ("kurento.BaseRtpEndpoint");
+    object["hierarchy"].append ("kurento.SdpEndpoint");
+    object["hierarchy"].append ("kurento.SessionEndpoint");
+    object["hierarchy"].append ("kurento.Endpoint");
+    object["hierarchy"].append ("kurento.MediaElement");
+    object["hierarchy"].append ("kurento.MediaObject");
+    describe["result"]["value"].append (object);
+  }
+
+  describe["jsonrpc"] = "2.0";
+  describe["id"] = 2;
+
+  kurento::writeJson (stats, statsStr);
+  kurento::writeJson (describe, describeStr);
+
+  for (int level : {
+         1, 6, 9
+       }) {
+    measureCompression ("getStats", statsStr, level);
+    measureCompression ("describe", describeStr, level);
+  }
+}
+
+/*
+ * Same requests through the JSON text protocol and the CBOR subprotocol.
+ * Both share the method dispatch, so the difference is the cost of the
+ * encodings; it is reported but not asserted.
+ */
+BOOST_AUTO_TEST_CASE ( binary_throughput )
+{
+  start ();
+
+  for (const std::string method : {
+         "invoke", "describe"
+       }) {
+    double json = measureEncoding (false, method);
+    double cbor = measureEncoding (true, method);
+
+    BOOST_TEST_MESSAGE (method << ": JSON " << json << " requests/s, CBOR "
+                        << cbor << " requests/s, x" << cbor / json);
+  }
+}
+
+BOOST_AUTO_TEST_CASE ( create_latency )
+{
+  start ();
+
+  measureCreate ("default open files");
+}
+
+/*
+ * Resource usage is sampled in the background, so create latency should not
+ * depend on the number of open files of the server.
+ */
+BOOST_AUTO_TEST_CASE ( create_latency_open_files )
+{
+  std::vector<int> fds = openFiles (CREATE_OPEN_FILES);
+
+  start ();
+
+  measureCreate (std::to_string (fds.size () ) + " open files");
+
+  for (int fd : fds) {
+    close (fd);
+  }
+}
+
+/*
+ * Requests of different sessions are processed in parallel, so aggregated
+ * throughput should grow with the number of concurrent sessions up to the
+ * number of RPC threads. How much depends on the host, so only the best
+ * throughput with several sessions is checked to be above the one of a
+ * single session.
+ */
+BOOST_AUTO_TEST_CASE ( session_scaling )
+{
+  unsigned maxSessions = std::max (std::thread::hardware_concurrency (), 1u);
+  double base;
+  double best = 0;
+
+  start ();
+
+  base = measureSessions (1);
+  BOOST_TEST_MESSAGE ("1 session: " << base << " requests/s");
+
+  for (unsigned sessions = 2; sessions <= maxSessions; sessions *= 2) {
+    double throughput = measureSessions (sessions);
+
+    BOOST_TEST_MESSAGE (sessions << " sessions: " << throughput
+                        << " requests/s, x" << throughput / base);
+    best = std::max (best, throughput);
+  }
+
+  if (maxSessions < 2) {
+    BOOST_TEST_MESSAGE ("Single CPU, scaling not checked");
+    return;
+  }
+
+  BOOST_CHECK_MESSAGE (best > base, "Throughput does not grow with sessions: "
+                       << best << " requests/s, " << base << " with one session");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} /* kurento */
@@ -0,0 +1,324 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "BaseTest.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/asio.hpp>
+
+#include <gst/gst.h>
+
+#include <json/json.h>
+#include <zlib.h>
+
+#include <sstream>
+#include <string>
+
+#define GST_CAT_DEFAULT _server_compression_test_
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "test_server_compression_test"
+
+namespace kurento
+{
+
+static const size_t THRESHOLD = 1024;
+static const std::string EXTENSIONS_HEADER = "Sec-WebSocket-Extensions:";
+
+/*
+ * WebSocket connection offering permessage-deflate, as the websocketpp client
+ * does not negotiate it. Frames are written and read by hand, so that the
+ * compression bit of each one is known.
+ */
+class DeflateClient
+{
+public:
+  DeflateClient (const std::string &uri);
+  ~DeflateClient ();
+
+  /* Extensions accepted by the server */
+  const std::string &getExtensions () const
+  {
+    return extensions;
+  }
+
+  void sendText (const std::string &payload, bool compressed);
+  /* Payload of the next data frame, inflated if it was compressed */
+  std::string receiveText (bool &compressed);
+
+private:
+  std::string deflatePayload (const std::string &payload);
+  std::string inflatePayload (std::string payload);
+
+  boost::asio::io_service ios;
+  boost::asio::ip::tcp::socket socket;
+  std::string extensions;
+
+  /* Contexts are kept between messages, as the offer does not disable
+   * context takeover */
+  z_stream deflater{};
+  z_stream inflater{};
+};
+
+DeflateClient::DeflateClient (const std::string &uri) : socket (ios)
+{
+  std::string address = uri.substr (uri.find ("//") + 2);
+  size_t portPos = address.find (':');
+  size_t pathPos = address.find ('/');
+  std::string host = address.substr (0, portPos);
+  std::string port = address.substr (portPos + 1, pathPos - portPos - 1);
+  boost::asio::ip::tcp::resolver resolver (ios);
+  boost::asio::streambuf response;
+  std::ostringstream request;
+  std::string line;
+
+  boost::asio::connect (socket, resolver.resolve (
+                          boost::asio::ip::tcp::resolver::query (host, port) ) );
+
+  request << "GET " << address.substr (pathPos) << " HTTP/1.1\r\n"
+          << "Host: " << host << ":" << port << "\r\n"
+          << "Upgrade: websocket\r\n"
+          << "Connection: Upgrade\r\n"
+          << "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+          << "Sec-WebSocket-Version: 13\r\n"
+          << EXTENSIONS_HEADER << " permessage-deflate\r\n\r\n";
+
+  boost::asio::write (socket, boost::asio::buffer (request.str () ) );
+  boost::asio::read_until (socket, response, "\r\n\r\n");
+
+  std::istream stream (&response);
+
+  std::getline (stream, line);
+  BOOST_REQUIRE_MESSAGE (line.find (" 101 ") != std::string::npos, line);
+
+  while (std::getline (stream, line) && line != "\r") {
+    if (line.compare (0, EXTENSIONS_HEADER.size (), EXTENSIONS_HEADER) == 0) {
+      extensions = line.substr (EXTENSIONS_HEADER.size () );
+    }
+  }
+
+  /* Nothing is sent by the server before the first request */
+  BOOST_REQUIRE_EQUAL (response.size (), 0);
+
+  BOOST_REQUIRE (deflateInit2 (&deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                               -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  BOOST_REQUIRE (inflateInit2 (&inflater, -15) == Z_OK);
+}
+
+DeflateClient::~DeflateClient ()
+{
+  deflateEnd (&deflater);
+  inflateEnd (&inflater);
+}
+
+std::string
+DeflateClient::deflatePayload (const std::string &payload)
+{
+  unsigned char buffer[16384];
+  std::string out;
+
+  deflater.avail_in = payload.size ();
+  deflater.next_in = (unsigned char *) const_cast<char *> (payload.data () );
+
+  do {
+    deflater.avail_out = sizeof (buffer);
+    deflater.next_out = buffer;
+    deflate (&deflater, Z_SYNC_FLUSH);
+    out.append ( (char *) buffer, sizeof (buffer) - deflater.avail_out);
+  } while (deflater.avail_out == 0);
+
+  /* The empty block ending the flush is not sent */
+  out.resize (out.size () - 4);
+
+  return out;
+}
+
+std::string
+DeflateClient::inflatePayload (std::string payload)
+{
+  unsigned char buffer[16384];
+  std::string out;
+
+  payload.append ("\x00\x00\xff\xff", 4);
+
+  inflater.avail_in = payload.size ();
+  inflater.next_in = (unsigned char *) const_cast<char *> (payload.data () );
+
+  do {
+    inflater.avail_out = sizeof (buffer);
+    inflater.next_out = buffer;
+    BOOST_REQUIRE (inflate (&inflater, Z_SYNC_FLUSH) != Z_DATA_ERROR);
+    out.append ( (char *) buffer, sizeof (buffer) - inflater.avail_out);
+  } while (inflater.avail_out == 0);
+
+  return out;
+}
+
+void
+DeflateClient::sendText (const std::string &payload, bool compressed)
+{
+  const unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+  std::string data = compressed ? deflatePayload (payload) : payload;
+  std::string frame;
+
+  /* FIN, RSV1 if compressed and text opcode */
+  frame.push_back ( (char) (0x81 | (compressed ? 0x40 : 0) ) );
+
+  if (data.size () < 126) {
+    frame.push_back ( (char) (0x80 | data.size () ) );
+  } else {
+    BOOST_REQUIRE (data.size () < 65536);
+    frame.push_back ( (char) (0x80 | 126) );
+    frame.push_back ( (char) (data.size () >> 8) );
+    frame.push_back ( (char) (data.size () & 0xff) );
+  }
+
+  /* Frames from clients are masked */
+  frame.append ( (const char *) mask, sizeof (mask) );
+
+  for (size_t i = 0; i < data.size (); i++) {
+    frame.push_back (data[i] ^ mask[i % sizeof (mask)]);
+  }
+
+  boost::asio::write (socket, boost::asio::buffer (frame) );
+}
+
+std::string
+DeflateClient::receiveText (bool &compressed)
+{
+  while (true) {
+    unsigned char header[2];
+    unsigned char extended[8];
+    uint64_t length;
+    std::string payload;
+
+    boost::asio::read (socket, boost::asio::buffer (header) );
+    length = header[1] & 0x7f;
+
+    if (length >= 126) {
+      size_t size = length == 126 ? 2 : 8;
+
+      boost::asio::read (socket, boost::asio::buffer (extended, size) );
+      length = 0;
+
+      for (size_t i = 0; i < size; i++) {
+        length = (length << 8) | extended[i];
+      }
+    }
+
+    payload.resize (length);
+
+    if (length > 0) {
+      boost::asio::read (socket, boost::asio::buffer (&payload[0], length) );
+    }
+
+    int opcode = header[0] & 0x0f;
+
+    BOOST_REQUIRE_MESSAGE (opcode != 0x8, "Connection closed by the server");
+
+    /* Other control frames, like pings, are ignored */
+    if (opcode >= 0x8) {
+      continue;
+    }
+
+    /* Responses are not fragmented */
+    BOOST_REQUIRE (header[0] & 0x80);
+
+    compressed = header[0] & 0x40;
+
+    return compressed ? inflatePayload (payload) : payload;
+  }
+}
+
+class ClientHandler : public F
+{
+public:
+  ClientHandler() : F()
+  {
+    GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+                             GST_DEFAULT_NAME);
+  };
+
+  ~ClientHandler() override = default;
+
+protected:
+  void check_compression ();
+
+private:
+  void check_ping (DeflateClient &client, const std::string &id,
+                   bool compressedRequest, bool compressedResponse);
+};
+
+/* The id is echoed in the response, so its size drives the size of both */
+void
+ClientHandler::check_ping (DeflateClient &client, const std::string &id,
+                           bool compressedRequest, bool compressedResponse)
+{
+  Json::StreamWriterBuilder writerFactory;
+  Json::CharReaderBuilder readerFactory;
+  Json::Value request;
+  Json::Value response;
+  std::string errs;
+  bool compressed;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = id;
+  request["method"] = "ping";
+
+  writerFactory["indentation"] = "";
+  client.sendText (Json::writeString (writerFactory, request),
+                   compressedRequest);
+
+  std::istringstream stream (client.receiveText (compressed) );
+
+  BOOST_REQUIRE (Json::parseFromStream (readerFactory, stream, &response,
+                                        &errs) );
+  BOOST_CHECK_EQUAL (compressed, compressedResponse);
+  BOOST_CHECK (response["id"].asString () == id);
+  BOOST_CHECK_EQUAL (response["result"]["value"].asString (), "pong");
+}
+
+void
+ClientHandler::check_compression ()
+{
+  DeflateClient client (getWsUri () );
+  const std::string small = "small";
+  const std::string large (2 * THRESHOLD, 'x');
+
+  BOOST_REQUIRE_MESSAGE (client.getExtensions ().find ("permessage-deflate") !=
+                         std::string::npos, "permessage-deflate not accepted");
+
+  /* Requests are accepted either way, responses are only compressed from
+   * the threshold */
+  check_ping (client, small, false, false);
+  check_ping (client, large, false, true);
+  check_ping (client, small, true, false);
+  check_ping (client, large, true, true);
+}
+
+BOOST_FIXTURE_TEST_SUITE ( server_compression_test, ClientHandler)
+
+BOOST_AUTO_TEST_CASE ( server_compression_test )
+{
+  setConfig ("mediaServer.net.websocket.compression.enabled", "true");
+  setConfig ("mediaServer.net.websocket.compression.threshold",
+             std::to_string (THRESHOLD) );
+  start ();
+  check_compression ();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} /* kurento */
@@ -42,6 +42,7 @@ public:
 
 protected:
   void check_create_duplicate_requests_call ();
+  void check_cache_stats ();
 };
 
 void
@@ -105,6 +106,33 @@ ClientHandler::check_create_duplicate_requests_call()
   BOOST_CHECK (response == response2);
 }
 
+void
+ClientHandler::check_cache_stats()
+{
+  Json::Value request;
+  Json::Value response;
+  Json::Value cache;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "stats";
+
+  response = sendRequest (request);
+
+  BOOST_CHECK (!response.isMember ("error") );
+  BOOST_REQUIRE (response.isMember ("result") );
+  BOOST_REQUIRE (response["result"]["value"].isMember ("requestCache") );
+
+  cache = response["result"]["value"]["requestCache"];
+
+  BOOST_CHECK (cache["enabled"].asBool() );
+  /* Both duplicated create requests were answered from the cache */
+  BOOST_CHECK (cache["hits"].asUInt64() >= 2);
+  BOOST_CHECK (cache["entries"].asUInt64() > 0);
+  BOOST_CHECK (cache["bytes"].asUInt64() > 0);
+  BOOST_CHECK (cache["bytes"].asUInt64() <= cache["maxBytes"].asUInt64() );
+}
+
 BOOST_FIXTURE_TEST_SUITE ( server_duplicate_reqs_test_suite, ClientHandler)
 
 BOOST_AUTO_TEST_CASE ( server_duplicate_reqs )
@@ -114,6 +142,7 @@ BOOST_AUTO_TEST_CASE ( server_duplicate_reqs )
 
   start();
   check_create_duplicate_requests_call();
+  check_cache_stats();
 }
 
 BOOST_AUTO_TEST_SUITE_END()
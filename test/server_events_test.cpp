@@ -18,11 +18,16 @@
 #include "BaseTest.hpp"
 #include <boost/test/unit_test.hpp>
 #include <KurentoException.hpp>
+#include <UUIDGenerator.hpp>
 
 #include <gst/gst.h>
 
 #include <json/json.h>
 
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #define GST_CAT_DEFAULT _server_json_test_
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "test_server_json_test"
@@ -30,6 +35,71 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 namespace kurento
 {
 
+/*
+ * Client subscribed to ObjectCreated events that stops reading once
+ * subscribed, as its I/O is not run anymore. Its receive buffer is small, so
+ * events are soon left pending on the server side.
+ */
+class StalledClient
+{
+public:
+  StalledClient (const std::string &uri)
+  {
+    websocketpp::lib::error_code ec;
+
+    client.clear_access_channels (websocketpp::log::alevel::all);
+    client.clear_error_channels (websocketpp::log::elevel::all);
+    client.init_asio ();
+
+    client.set_socket_init_handler ([] (websocketpp::connection_hdl hdl,
+    boost::asio::ip::tcp::socket & socket) {
+      socket.set_option (boost::asio::socket_base::receive_buffer_size (4096) );
+    });
+
+    client.set_open_handler ([this] (websocketpp::connection_hdl hdl) {
+      Json::StreamWriterBuilder writerFactory;
+      Json::Value request;
+
+      request["jsonrpc"] = "2.0";
+      request["id"] = 0;
+      request["method"] = "subscribe";
+      request["params"]["object"] = "manager_ServerManager";
+      request["params"]["type"] = "ObjectCreated";
+
+      writerFactory["indentation"] = "";
+      client.send (hdl, Json::writeString (writerFactory, request),
+                   websocketpp::frame::opcode::text);
+    });
+
+    /* The first message is the response to the subscription */
+    client.set_message_handler ([this] (websocketpp::connection_hdl hdl,
+    WebSocketClient::message_ptr msg) {
+      subscribed = true;
+    });
+
+    WebSocketClient::connection_ptr connection = client.get_connection (uri,
+        ec);
+
+    BOOST_REQUIRE (!ec);
+    client.connect (connection);
+
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now () + std::chrono::seconds (5);
+
+    while (!subscribed && std::chrono::steady_clock::now () < deadline) {
+      if (client.poll_one () == 0) {
+        std::this_thread::sleep_for (std::chrono::milliseconds (10) );
+      }
+    }
+
+    BOOST_REQUIRE_MESSAGE (subscribed, "Stalled client not subscribed");
+  }
+
+private:
+  WebSocketClient client;
+  bool subscribed = false;
+};
+
 class ClientHandler : public F
 {
 public:
@@ -39,6 +109,20 @@ public:
 
 protected:
   void check_not_duplicated_event ();
+  void check_event_queue_stats ();
+  void check_event_order ();
+  void check_event_queue_drop ();
+  void check_event_queue_close ();
+
+  /* Bursts sent at most to overflow the queue of a stalled client */
+  static const int MAX_BURSTS = 200;
+
+private:
+  std::string subscribeObjectCreated ();
+  Json::Value createObjectsRequest (const std::string &sessionId);
+  Json::Value getWebSocketStats (const std::string &sessionId);
+  template <typename Predicate>
+  void runBursts (Predicate stop);
 };
 
 static std::string
@@ -252,6 +336,219 @@ ClientHandler::check_not_duplicated_event()
   // Unsubscribe second listener and no event should be received
 }
 
+std::string
+ClientHandler::subscribeObjectCreated ()
+{
+  Json::Value request;
+  Json::Value response;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "subscribe";
+  request["params"]["object"] = "manager_ServerManager";
+  request["params"]["type"] = "ObjectCreated";
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (response.isMember ("result") );
+
+  return response["result"]["sessionId"].asString();
+}
+
+/* Creates a pipeline and its endpoints concurrently, each object raising an
+ * ObjectCreated event, so events are queued in bursts */
+Json::Value
+ClientHandler::createObjectsRequest (const std::string &sessionId)
+{
+  const unsigned ENDPOINTS = 64;
+  Json::Value request;
+  Json::Value operation;
+
+  operation["jsonrpc"] = "2.0";
+  operation["method"] = "create";
+  operation["id"] = 0;
+  operation["params"]["type"] = "MediaPipeline";
+  operation["params"]["constructorParams"] = Json::Value (Json::objectValue);
+  request["params"]["operations"].append (operation);
+
+  operation["params"]["type"] = "WebRtcEndpoint";
+  operation["params"]["constructorParams"]["mediaPipeline"] = "newref:0";
+
+  for (unsigned i = 1; i <= ENDPOINTS; i++) {
+    operation["id"] = i;
+    request["params"]["operations"].append (operation);
+  }
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "transaction";
+  request["params"]["sessionId"] = sessionId;
+
+  return request;
+}
+
+Json::Value
+ClientHandler::getWebSocketStats (const std::string &sessionId)
+{
+  Json::Value request;
+  Json::Value response;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "stats";
+  request["params"]["sessionId"] = sessionId;
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (response.isMember ("result") );
+  BOOST_REQUIRE (response["result"]["value"].isMember ("webSocket") );
+
+  return response["result"]["value"]["webSocket"];
+}
+
+void
+ClientHandler::check_event_queue_stats ()
+{
+  std::string sessionId = subscribeObjectCreated ();
+  Json::Value request;
+  Json::Value response;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "create";
+  request["params"]["type"] = "MediaPipeline";
+  request["params"]["sessionId"] = sessionId;
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (response.isMember ("result") );
+
+  try {
+    waifForEvent (std::chrono::seconds (2) );
+  } catch (const kurento::KurentoException &e) {
+    BOOST_FAIL ("Expected event not received");
+  }
+
+  /* The event went through the session event queue */
+  Json::Value stats = getWebSocketStats (sessionId);
+  Json::Value &queue = stats["eventQueue"];
+
+  BOOST_CHECK (queue["sent"].asUInt64() >= 1);
+  BOOST_CHECK (queue["dropped"].asUInt64() == 0);
+  BOOST_CHECK (queue["overflowCloses"].asUInt64() == 0);
+  BOOST_CHECK (queue["overflowPolicy"].asString() == "drop");
+
+  Json::Value &session = stats["session"];
+
+  BOOST_CHECK (session["sessionId"].asString() == sessionId);
+  BOOST_CHECK (session["events"].asUInt64() >= 1);
+  BOOST_CHECK (session["bytes"].asUInt64() > 0);
+}
+
+/* Requests of a session are processed in order, so are the events they
+ * raise, which must arrive in that order although they are written by any
+ * of the I/O threads */
+void
+ClientHandler::check_event_order ()
+{
+  const int EVENTS = 50;
+  std::string sessionId = subscribeObjectCreated ();
+  std::vector<std::string> requestIds;
+  std::vector<std::string> objectIds;
+
+  /* Not waiting for each response, so events are queued in bursts */
+  for (int i = 0; i < EVENTS; i++) {
+    Json::Value request;
+
+    request["jsonrpc"] = "2.0";
+    request["id"] = getId();
+    request["method"] = "create";
+    request["params"]["type"] = "MediaPipeline";
+    request["params"]["sessionId"] = sessionId;
+
+    requestIds.push_back (request["id"].asString () );
+    send (request);
+  }
+
+  for (const std::string &requestId : requestIds) {
+    Json::Value response = waitForResponse (requestId);
+
+    BOOST_REQUIRE (response.isMember ("result") );
+    objectIds.push_back (response["result"]["value"].asString () );
+  }
+
+  for (int i = 0; i < EVENTS; i++) {
+    Json::Value event;
+
+    try {
+      event = waifForEvent (std::chrono::seconds (2) );
+    } catch (const kurento::KurentoException &e) {
+      BOOST_FAIL ("Expected event not received");
+    }
+
+    BOOST_CHECK_EQUAL (event["params"]["value"]["data"]["object"].asString (),
+                       objectIds[i]);
+  }
+}
+
+/* Runs the given number of bursts, or until stop returns true, releasing
+ * the objects created by each one */
+template <typename Predicate>
+void
+ClientHandler::runBursts (Predicate stop)
+{
+  std::string sessionId = generateUUID ();
+
+  for (int i = 0; i < MAX_BURSTS && !stop (sessionId); i++) {
+    Json::Value response = sendRequest (createObjectsRequest (sessionId) );
+    Json::Value request;
+
+    BOOST_REQUIRE (response.isMember ("result") );
+
+    request["jsonrpc"] = "2.0";
+    request["id"] = getId();
+    request["method"] = "release";
+    request["params"]["object"] =
+      response["result"]["value"][0]["result"]["value"];
+    request["params"]["sessionId"] = sessionId;
+
+    response = sendRequest (request);
+
+    BOOST_REQUIRE (response.isMember ("result") );
+  }
+}
+
+void
+ClientHandler::check_event_queue_drop ()
+{
+  StalledClient stalled (getWsUri () );
+  Json::Value stats;
+
+  runBursts ([&] (const std::string & sessionId) {
+    stats = getWebSocketStats (sessionId);
+    return stats["eventQueue"]["dropped"].asUInt64() > 0;
+  });
+
+  BOOST_CHECK (stats["eventQueue"]["overflowPolicy"].asString() == "drop");
+  BOOST_CHECK (stats["eventQueue"]["dropped"].asUInt64() > 0);
+  BOOST_CHECK (stats["eventQueue"]["overflowCloses"].asUInt64() == 0);
+}
+
+void
+ClientHandler::check_event_queue_close ()
+{
+  StalledClient stalled (getWsUri () );
+  Json::Value stats;
+
+  runBursts ([&] (const std::string & sessionId) {
+    stats = getWebSocketStats (sessionId);
+    return stats["eventQueue"]["overflowCloses"].asUInt64() > 0;
+  });
+
+  BOOST_CHECK (stats["eventQueue"]["overflowPolicy"].asString() == "close");
+  BOOST_CHECK (stats["eventQueue"]["overflowCloses"].asUInt64() > 0);
+}
+
 BOOST_FIXTURE_TEST_SUITE ( server_unexpected_test_suite, ClientHandler)
 
 BOOST_AUTO_TEST_CASE ( server_unexpected_test )
@@ -263,6 +560,36 @@ BOOST_AUTO_TEST_CASE ( server_unexpected_test )
   check_not_duplicated_event();
 }
 
+BOOST_AUTO_TEST_CASE ( event_queue_stats )
+{
+  start ();
+  check_event_queue_stats();
+}
+
+BOOST_AUTO_TEST_CASE ( event_order )
+{
+  start ();
+  check_event_order();
+}
+
+BOOST_AUTO_TEST_CASE ( event_queue_overflow_drop )
+{
+  setConfig ("mediaServer.net.websocket.eventQueueSize", "10");
+  setConfig ("mediaServer.net.websocket.eventQueueMaxBuffered", "1024");
+  setConfig ("mediaServer.net.websocket.eventQueueOverflow", "drop");
+  start ();
+  check_event_queue_drop();
+}
+
+BOOST_AUTO_TEST_CASE ( event_queue_overflow_close )
+{
+  setConfig ("mediaServer.net.websocket.eventQueueSize", "10");
+  setConfig ("mediaServer.net.websocket.eventQueueMaxBuffered", "1024");
+  setConfig ("mediaServer.net.websocket.eventQueueOverflow", "close");
+  start ();
+  check_event_queue_close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } /* kurento */
@@ -23,6 +23,9 @@
 
 #include <json/json.h>
 
+#include <map>
+#include <set>
+
 #define GST_CAT_DEFAULT _server_json_test_
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "test_server_json_test"
@@ -47,6 +50,12 @@ protected:
   void check_connect_call ();
   void check_bad_transaction_call ();
   void check_transaction_call ();
+  void check_transaction_param_string ();
+  void check_parallel_transaction_call ();
+  void check_prepared_transaction_call ();
+  void check_batch_call ();
+  void check_startup_stats ();
+  void check_admission_stats ();
 
   void runTests ()
   {
@@ -56,6 +65,26 @@ protected:
     check_create_pipeline_call();
     check_bad_transaction_call();
     check_transaction_call();
+    check_transaction_param_string();
+    check_parallel_transaction_call();
+    check_prepared_transaction_call();
+    check_batch_call();
+    check_startup_stats();
+    check_admission_stats();
+  }
+
+  /* Same requests, encoded in CBOR */
+  void runCborTests ()
+  {
+    setCbor (true);
+    start ();
+
+    BOOST_REQUIRE (isBinary () );
+
+    check_error_call();
+    check_create_pipeline_call();
+    check_transaction_call();
+    check_batch_call();
   }
 };
 
@@ -196,6 +225,169 @@ ClientHandler::check_transaction_call()
                Json::ValueType::nullValue);
 }
 
+/* Only prepared transactions take parameters, other strings are kept */
+void
+ClientHandler::check_transaction_param_string()
+{
+  Json::Value response, request;
+  Json::Reader reader;
+  std::string req_str;
+
+  req_str =
+      "{\"id\":" + std::to_string(getId()) +
+      R"(,"jsonrpc":"2.0","method":"transaction","params":{"operations":[{"id":0,"jsonrpc":"2.0","method":"create","params":{"constructorParams":{},"type":"MediaPipeline"}},{"id":1,"jsonrpc":"2.0","method":"invoke","params":{"object":"newref:0","operation":"setName","operationParams":{"name":"param:name"}}},{"id":2,"jsonrpc":"2.0","method":"invoke","params":{"object":"newref:0","operation":"getName","operationParams":{}}}],"sessionId":"param-string-transaction"}})";
+
+  BOOST_REQUIRE (reader.parse (req_str, request) );
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (!response.isMember ("error") );
+  BOOST_REQUIRE (response["result"]["value"].isArray () );
+  BOOST_REQUIRE_EQUAL (response["result"]["value"].size (), 3);
+  BOOST_CHECK (!response["result"]["value"][1].isMember ("error") );
+  BOOST_CHECK_EQUAL (
+    response["result"]["value"][2]["result"]["value"].asString (),
+    "param:name");
+}
+
+/*
+ * Endpoints only depend on the pipeline, so they are created concurrently.
+ * Results must still be in order and stop at the first failure.
+ */
+void
+ClientHandler::check_parallel_transaction_call()
+{
+  Json::Value request;
+  Json::Value response;
+  Json::Value params;
+  Json::Value operations;
+  Json::Value operation;
+  Json::Value opParams;
+  const unsigned endpoints = 8;
+
+  operation["jsonrpc"] = "2.0";
+  operation["method"] = "create";
+  operation["id"] = 0;
+  opParams["type"] = "MediaPipeline";
+  opParams["constructorParams"] = Json::Value (Json::objectValue);
+  operation["params"] = opParams;
+  operations.append (operation);
+
+  opParams["type"] = "WebRtcEndpoint";
+  opParams["constructorParams"]["mediaPipeline"] = "newref:0";
+
+  for (unsigned i = 1; i <= endpoints + 2; i++) {
+    operation["id"] = i;
+    /* The one before the last fails */
+    opParams["type"] = (i == endpoints + 1) ? "NonExistingType" : "WebRtcEndpoint";
+    operation["params"] = opParams;
+    operations.append (operation);
+  }
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "transaction";
+  params["operations"] = operations;
+  params["sessionId"] = "parallel-transaction";
+  request["params"] = params;
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (!response.isMember ("error") );
+
+  Json::Value &results = response["result"]["value"];
+
+  BOOST_REQUIRE (results.isArray () );
+  BOOST_REQUIRE_EQUAL (results.size (), endpoints + 2);
+
+  for (unsigned i = 0; i <= endpoints; i++) {
+    BOOST_CHECK (results[i]["id"].asUInt () == i);
+    BOOST_CHECK (results[i]["result"]["value"].isString () );
+  }
+
+  BOOST_CHECK (results[endpoints + 1].isMember ("error") );
+}
+
+void
+ClientHandler::check_prepared_transaction_call()
+{
+  Json::Value response, request;
+  Json::Value params;
+  Json::Reader reader;
+  std::string req_str;
+
+  req_str =
+      "{\"id\":" + std::to_string(getId()) +
+      R"(,"jsonrpc":"2.0","method":"prepareTransaction","params":{"name":"player","operations":[{"id":0,"jsonrpc":"2.0","method":"create","params":{"constructorParams":{},"type":"MediaPipeline"}},{"id":1,"jsonrpc":"2.0","method":"create","params":{"constructorParams":{"mediaPipeline":"newref:0","uri":"param:uri"},"type":"PlayerEndpoint"}},{"id":2,"jsonrpc":"2.0","method":"create","params":{"constructorParams":{"mediaPipeline":"newref:0"},"type":"WebRtcEndpoint"}},{"id":3,"jsonrpc":"2.0","method":"invoke","params":{"object":"newref:1","operation":"connect","operationParams":{"sink":"newref:2"}}}],"sessionId":"prepared-transaction"}})";
+
+  BOOST_REQUIRE (reader.parse (req_str, request) );
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (!response.isMember ("error") );
+  BOOST_REQUIRE (response["result"]["value"].isArray () );
+  BOOST_CHECK (response["result"]["value"].size () == 1);
+  BOOST_CHECK (response["result"]["value"][0] == "uri");
+
+  /* Other sessions can not replace it */
+  request["id"] = getId();
+  request["params"]["sessionId"] = "other-session";
+  request["params"]["operations"].resize (1);
+  response = sendRequest (request);
+
+  BOOST_CHECK (response.isMember ("error") );
+
+  request.clear ();
+  request["jsonrpc"] = "2.0";
+  request["method"] = "transaction";
+  params["template"] = "player";
+  params["sessionId"] = "prepared-transaction";
+
+  /* Parameters are required */
+  request["id"] = getId();
+  request["params"] = params;
+  response = sendRequest (request);
+
+  BOOST_CHECK (response.isMember ("error") );
+
+  params["parameters"]["uri"] = "http://files.openvidu.io/video/format/small.webm";
+  request["params"] = params;
+
+  for (int i = 0; i < 2; i++) {
+    request["id"] = getId();
+    response = sendRequest (request);
+
+    BOOST_REQUIRE (!response.isMember ("error") );
+    BOOST_REQUIRE (response["result"]["value"].isArray () );
+    BOOST_CHECK (response["result"]["value"].size () == 4);
+    BOOST_CHECK (!response["result"]["value"][3].isMember ("error") );
+  }
+
+  request.clear ();
+  params.clear ();
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "releaseTransaction";
+  params["name"] = "player";
+
+  /* Nor release it */
+  params["sessionId"] = "other-session";
+  request["params"] = params;
+  response = sendRequest (request);
+
+  BOOST_CHECK (response.isMember ("error") );
+
+  params["sessionId"] = "prepared-transaction";
+  request["id"] = getId();
+  request["params"] = params;
+  response = sendRequest (request);
+
+  BOOST_CHECK (!response.isMember ("error") );
+
+  request["id"] = getId();
+  response = sendRequest (request);
+
+  BOOST_CHECK (response.isMember ("error") );
+}
+
 void
 ClientHandler::check_create_pipeline_call()
 {
@@ -326,6 +518,118 @@ ClientHandler::check_create_pipeline_call()
   BOOST_CHECK (response["result"]["sessionId"].asString () == sessionId );
 }
 
+void
+ClientHandler::check_batch_call()
+{
+  Json::Value batch;
+  Json::Value request;
+  Json::Value response;
+  Json::Value params;
+  std::map<std::string, Json::Value> responses;
+  std::string sessionId = "batch-session";
+
+  request["jsonrpc"] = "2.0";
+  request["method"] = "create";
+  params["type"] = "MediaPipeline";
+  params["sessionId"] = sessionId;
+  request["params"] = params;
+
+  for (int i = 0; i < 4; i++) {
+    request["id"] = "create-" + std::to_string (i);
+    batch.append (request);
+  }
+
+  request["id"] = "bad";
+  request["method"] = "nonExistingMethod";
+  batch.append (request);
+
+  /* Notifications get no response */
+  request.removeMember ("id");
+  request["method"] = "ping";
+  batch.append (request);
+
+  response = sendBatch (batch);
+
+  BOOST_REQUIRE (response.isArray () );
+  BOOST_REQUIRE_EQUAL (response.size (), 5u);
+
+  for (const Json::Value &entry : response) {
+    responses[entry["id"].asString ()] = entry;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    Json::Value &entry = responses["create-" + std::to_string (i)];
+
+    BOOST_CHECK (!entry.isMember ("error") );
+    BOOST_CHECK (entry["result"]["value"].isString () );
+    BOOST_CHECK (entry["result"]["sessionId"].asString () == sessionId);
+  }
+
+  BOOST_CHECK (responses["bad"].isMember ("error") );
+  BOOST_CHECK (responses["bad"]["error"]["code"].asInt() == -32601);
+}
+
+void
+ClientHandler::check_startup_stats()
+{
+  Json::Value request;
+  Json::Value response;
+  Json::Value startup;
+  std::set<std::string> phases;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "stats";
+  request["params"] = Json::Value (Json::objectValue);
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (response["result"]["value"].isMember ("startup") );
+
+  startup = response["result"]["value"]["startup"];
+
+  BOOST_CHECK (startup["ready"].asBool () );
+  BOOST_CHECK (startup["totalMs"].asDouble () > 0);
+  BOOST_CHECK (startup["modules"]["loaded"].isArray () );
+
+  for (const Json::Value &phase : startup["phases"]) {
+    BOOST_CHECK (phase["ms"].asDouble () >= 0);
+    phases.insert (phase["name"].asString () );
+  }
+
+  BOOST_CHECK (phases.count ("loadModules") );
+  BOOST_CHECK (phases.count ("startTransport") );
+}
+
+void
+ClientHandler::check_admission_stats()
+{
+  Json::Value request;
+  Json::Value response;
+  Json::Value admission;
+
+  request["jsonrpc"] = "2.0";
+  request["id"] = getId();
+  request["method"] = "stats";
+  request["params"] = Json::Value (Json::objectValue);
+
+  response = sendRequest (request);
+
+  BOOST_REQUIRE (response["result"]["value"].isMember ("admission") );
+
+  admission = response["result"]["value"]["admission"];
+
+  /* Pipelines have been created by the previous checks */
+  BOOST_CHECK (admission["admissions"].asUInt64 () > 0);
+  BOOST_CHECK (admission["factories"]["MediaPipeline"]["observations"].asUInt64 ()
+               > 0);
+  BOOST_CHECK (admission["factories"]["MediaPipeline"]["threads"].asDouble ()
+               >= 0);
+  BOOST_CHECK (!admission["rejecting"].asBool () );
+  BOOST_CHECK (response["result"]["value"]["resources"]["load"].asDouble ()
+               > 0);
+}
+
 BOOST_FIXTURE_TEST_SUITE ( server_json_test, ClientHandler)
 
 BOOST_AUTO_TEST_CASE ( server_json_test )
@@ -333,6 +637,11 @@ BOOST_AUTO_TEST_CASE ( server_json_test )
   runTests();
 }
 
+BOOST_AUTO_TEST_CASE ( server_cbor_test )
+{
+  runCborTests();
+}
+
 //BOOST_AUTO_TEST_CASE ( server_json_test_ipv6 )
 //{
 //  setWsHost ("ip6-localhost");
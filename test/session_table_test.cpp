@@ -0,0 +1,73 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#define BOOST_TEST_MODULE SessionTable
+#include <boost/test/unit_test.hpp>
+
+#include <SessionTable.hpp>
+
+using namespace kurento;
+
+static bool
+exists (SessionTable &table, const std::string &sessionId)
+{
+  return table.find (sessionId, [] (SessionTable::Session &) {});
+}
+
+/* Sessions whose subscriptions outlive the connection are removed once the
+ * handlers are released */
+BOOST_AUTO_TEST_CASE ( purge_released_handlers )
+{
+  SessionTable table;
+  /* Only the lifetime of the handler matters */
+  std::shared_ptr<EventHandler> handler (std::make_shared<int> (), nullptr);
+  std::shared_ptr<EventHandler> released (std::make_shared<int> (), nullptr);
+
+  table.modify ("session", [&] (SessionTable::Session & session) {
+    session.handlers["object|event"] = handler;
+    session.handlers["object|other"] = released;
+  });
+
+  released.reset ();
+
+  BOOST_CHECK_EQUAL (table.purge (), 0);
+  BOOST_REQUIRE (exists (table, "session") );
+
+  table.find ("session", [] (SessionTable::Session & session) {
+    BOOST_CHECK_EQUAL (session.handlers.size (), 1);
+  });
+
+  handler.reset ();
+
+  BOOST_CHECK_EQUAL (table.purge (), 1);
+  BOOST_CHECK (!exists (table, "session") );
+}
+
+BOOST_AUTO_TEST_CASE ( purge_keeps_connected )
+{
+  SessionTable table;
+  std::shared_ptr<int> connection = std::make_shared<int> ();
+
+  table.modify ("connected", [&] (SessionTable::Session & session) {
+    session.connection = connection;
+  });
+  table.modify ("unused", [] (SessionTable::Session &) {});
+
+  BOOST_CHECK_EQUAL (table.purge (), 1);
+  BOOST_CHECK (exists (table, "connected") );
+  BOOST_CHECK (!exists (table, "unused") );
+}